@@ -5,7 +5,12 @@
 #include <string.h>
 #include <strings.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/random.h>
 
+#include "wuy_siphash.h"
 #include "wuy_dict.h"
 
 struct wuy_dict_s {
@@ -13,9 +18,11 @@ struct wuy_dict_s {
 	wuy_dict_equal_f	*key_equal;
 	wuy_dict_key_type_e	key_type;
 	size_t			key_offset;
+	size_t			key_len;
 
 	wuy_hlist_t		*buckets;
 	wuy_hlist_t		*prev_buckets;
+	uint32_t		prev_size;
 
 	uint32_t		bucket_size;
 	uint32_t		split;
@@ -25,11 +32,30 @@ struct wuy_dict_s {
 	size_t			count;
 
 	bool			expansion;
+	bool			hash_cache;
+
+	bool			keyed_hash;
+	uint8_t			hash_key[16];
+
+	bool			multimap;
+
+#ifdef WUY_DICT_STATS
+	uint64_t		stat_gets;
+	uint64_t		stat_hits;
+	uint64_t		stat_probes;
+#endif
 };
 
+#ifdef WUY_DICT_STATS
+#define WUY_DICT_STAT_INC(dict, name, n)	(dict)->stat_##name += (n)
+#else
+#define WUY_DICT_STAT_INC(dict, name, n)
+#endif
+
 #define WUY_DICT_SIZE_INIT		64
 #define WUY_DICT_SIZE_MAX		(64*1024*1024)
 #define WUY_DICT_EXPANSION_FACTOR	2
+#define WUY_DICT_SHRINK_FACTOR		4
 
 static wuy_dict_t *wuy_dict_new(size_t node_offset)
 {
@@ -44,7 +70,15 @@ static wuy_dict_t *wuy_dict_new(size_t node_offset)
 	dict->count = 0;
 	dict->split = 0;
 	dict->prev_buckets = NULL;
+	dict->prev_size = 0;
 	dict->expansion = true;
+	dict->hash_cache = false;
+	dict->keyed_hash = false;
+	dict->multimap = false;
+#ifdef WUY_DICT_STATS
+	dict->stat_gets = dict->stat_hits = dict->stat_probes = 0;
+#endif
+	dict->key_len = 0;
 	return dict;
 }
 
@@ -70,6 +104,13 @@ wuy_dict_t *wuy_dict_new_type(wuy_dict_key_type_e key_type,
 	return dict;
 }
 
+wuy_dict_t *wuy_dict_new_binary(size_t key_len, size_t key_offset, size_t node_offset)
+{
+	wuy_dict_t *dict = wuy_dict_new_type(WUY_DICT_KEY_BINARY, key_offset, node_offset);
+	dict->key_len = key_len;
+	return dict;
+}
+
 void wuy_dict_destroy(wuy_dict_t *dict)
 {
 	free(dict->prev_buckets);
@@ -94,10 +135,90 @@ void wuy_dict_disable_expasion(wuy_dict_t *dict, uint32_t bucket_size)
 	bzero(dict->buckets, align * sizeof(wuy_hlist_t));
 }
 
+void wuy_dict_enable_hash_cache(wuy_dict_t *dict)
+{
+	assert(dict->count == 0);
+
+	dict->hash_cache = true;
+}
+
+void wuy_dict_enable_multimap(wuy_dict_t *dict)
+{
+	assert(dict->count == 0);
+	dict->multimap = true;
+}
+
+/* A predictable key defeats the keyed hash, so it aborts if no
+ * random source works, instead of falling back to random(). */
+static void wuy_dict_random_key(uint8_t *key, size_t len)
+{
+	size_t pos = 0;
+	while (pos < len) {
+		ssize_t n = getrandom(key + pos, len - pos, 0);
+		if (n > 0) {
+			pos += n;
+		} else if (n < 0 && errno != EINTR) {
+			break;
+		}
+	}
+	if (pos == len) {
+		return;
+	}
+
+	/* getrandom() is not supported by old kernels */
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		abort();
+	}
+	for (size_t i = 0; i < len; ) {
+		ssize_t n = read(fd, key + i, len - i);
+		if (n > 0) {
+			i += n;
+		} else if (n == 0 || errno != EINTR) {
+			abort();
+		}
+	}
+	close(fd);
+}
+
+void wuy_dict_enable_keyed_hash(wuy_dict_t *dict)
+{
+	assert(dict->count == 0);
+	assert(dict->key_hash == NULL);
+
+	dict->keyed_hash = true;
+	wuy_dict_random_key(dict->hash_key, sizeof(dict->hash_key));
+}
+
 static const void *_item_to_key(wuy_dict_t *dict, const void *item)
 {
 	return (const char *)item + dict->key_offset;
 }
+
+/* convert the item's key into the form of searching key,
+ * which is passed to wuy_dict_get() */
+static const void *_item_to_search_key(wuy_dict_t *dict, const void *item)
+{
+	if (dict->key_equal != NULL) {
+		return item;
+	}
+
+	const void *item_key = _item_to_key(dict, item);
+	switch (dict->key_type) {
+	case WUY_DICT_KEY_UINT32:
+		return (const void *)(uintptr_t)*(uint32_t *)item_key;
+	case WUY_DICT_KEY_UINT64:
+		return (const void *)(uintptr_t)*(uint64_t *)item_key;
+	case WUY_DICT_KEY_STRING:
+	case WUY_DICT_KEY_POINTER:
+		return *(const void **)item_key;
+	case WUY_DICT_KEY_LSTRING:
+	case WUY_DICT_KEY_BINARY:
+		return item_key;
+	default:
+		abort();
+	}
+}
 static wuy_hlist_node_t *_item_to_node(wuy_dict_t *dict, const void *item)
 {
 	return (wuy_hlist_node_t *)((char *)item + dict->node_offset);
@@ -106,25 +227,30 @@ static void *_node_to_item(wuy_dict_t *dict, wuy_hlist_node_t *node)
 {
 	return (char *)node - dict->node_offset;
 }
+static wuy_dict_hash_node_t *_node_to_hash_node(wuy_hlist_node_t *node)
+{
+	return wuy_containerof(node, wuy_dict_hash_node_t, hlist_node);
+}
+
+static uint32_t wuy_dict_hash_keyed(wuy_dict_t *dict, const void *data, size_t len)
+{
+	uint64_t hash = wuy_siphash(data, len, dict->hash_key);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
 
 static uint32_t wuy_dict_hash_key(wuy_dict_t *dict, const void *key)
 {
 	if (dict->key_hash != NULL) {
 		return dict->key_hash(key);
 	}
-
-	switch (dict->key_type) {
-	case WUY_DICT_KEY_UINT32:
-		return (uint32_t)(uintptr_t)key;
-	case WUY_DICT_KEY_UINT64:
-		return (uint64_t)key;
-	case WUY_DICT_KEY_STRING:
-		return wuy_dict_hash_string(key);
-	case WUY_DICT_KEY_POINTER:
-		return wuy_dict_hash_pointer(key);
-	default:
-		abort();
+	if (dict->keyed_hash) {
+		uint64_t buf;
+		size_t len;
+		const void *data = _wuy_dict_type_key_data(dict->key_type,
+				dict->key_len, key, &buf, &len);
+		return wuy_dict_hash_keyed(dict, data, len);
 	}
+	return _wuy_dict_type_hash_key(dict->key_type, dict->key_len, key);
 }
 static uint32_t wuy_dict_hash_item(wuy_dict_t *dict, const void *item)
 {
@@ -133,26 +259,28 @@ static uint32_t wuy_dict_hash_item(wuy_dict_t *dict, const void *item)
 	}
 
 	const void *item_key = _item_to_key(dict, item);
-	switch (dict->key_type) {
-	case WUY_DICT_KEY_UINT32:
-		return *(uint32_t *)item_key;
-	case WUY_DICT_KEY_UINT64:
-		return (uint32_t)(*(uint64_t *)item_key);
-	case WUY_DICT_KEY_STRING:
-		return wuy_dict_hash_string(*(const char **)item_key);
-	case WUY_DICT_KEY_POINTER:
-		return wuy_dict_hash_pointer(*(const char **)item_key);
-	default:
-		abort();
+	if (dict->keyed_hash) {
+		size_t len;
+		const void *data = _wuy_dict_type_item_key_data(dict->key_type,
+				dict->key_len, item_key, &len);
+		return wuy_dict_hash_keyed(dict, data, len);
 	}
+	return _wuy_dict_type_hash_item_key(dict->key_type, dict->key_len, item_key);
 }
-static uint32_t wuy_dict_index_key(wuy_dict_t *dict, const void *key)
+uint32_t _wuy_dict_key_hash(wuy_dict_t *dict, const void *key)
 {
-	return wuy_dict_hash_key(dict, key) & (dict->bucket_size - 1);
+	return wuy_dict_hash_key(dict, key);
 }
-static uint32_t wuy_dict_index_item(wuy_dict_t *dict, const void *item)
+uint32_t wuy_dict_item_hash(wuy_dict_t *dict, const void *item)
 {
-	return wuy_dict_hash_item(dict, item) & (dict->bucket_size - 1);
+	return wuy_dict_hash_item(dict, item);
+}
+
+static uint32_t wuy_dict_index_node(wuy_dict_t *dict, wuy_hlist_node_t *node)
+{
+	uint32_t hash = dict->hash_cache ? _node_to_hash_node(node)->hash
+			: wuy_dict_hash_item(dict, _node_to_item(dict, node));
+	return hash & (dict->bucket_size - 1);
 }
 
 static bool wuy_dict_equal_key(wuy_dict_t *dict, const void *item, const void *key)
@@ -160,20 +288,25 @@ static bool wuy_dict_equal_key(wuy_dict_t *dict, const void *item, const void *k
 	if (dict->key_equal != NULL) {
 		return dict->key_equal(item, key);
 	}
+	return _wuy_dict_type_equal_key(dict->key_type, dict->key_len,
+			_item_to_key(dict, item), key);
+}
 
-	const void *item_key = _item_to_key(dict, item);
-	switch (dict->key_type) {
-	case WUY_DICT_KEY_UINT32:
-		return *(uint32_t *)item_key == (uint32_t)(uintptr_t)key;
-	case WUY_DICT_KEY_UINT64:
-		return *(uint64_t *)item_key == (uint64_t)key;
-	case WUY_DICT_KEY_STRING:
-		return strcmp(*(const char **)item_key, key) == 0;
-	case WUY_DICT_KEY_POINTER:
-		return *(uintptr_t *)item_key == (uintptr_t)key;
-	default:
-		abort();
+/* Switch to new buckets with new_size. The nodes in the previous
+ * buckets are moved into the new buckets incrementally, one bucket
+ * at each operation. */
+static void wuy_dict_resize(wuy_dict_t *dict, uint32_t new_size)
+{
+	wuy_hlist_t *newb = calloc(new_size, sizeof(wuy_hlist_t));
+	if (newb == NULL) {
+		/* if calloc fails, do nothing */
+		return;
 	}
+	dict->prev_buckets = dict->buckets;
+	dict->prev_size = dict->bucket_size;
+	dict->buckets = newb;
+	dict->bucket_size = new_size;
+	dict->split = 0;
 }
 
 static void wuy_dict_expasion(wuy_dict_t *dict)
@@ -182,45 +315,89 @@ static void wuy_dict_expasion(wuy_dict_t *dict)
 		return;
 	}
 
-	/* expansion */
-	if (dict->count >= dict->bucket_size * WUY_DICT_EXPANSION_FACTOR
-			&& dict->prev_buckets == NULL
-			&& dict->bucket_size < WUY_DICT_SIZE_MAX) {
-
-		wuy_hlist_t *newb = calloc(dict->bucket_size * 2, sizeof(wuy_hlist_t));
-		if (newb == NULL) {
-			/* if calloc fails, do nothing */
-			return;
+	if (dict->prev_buckets == NULL) {
+		/* expansion */
+		if (dict->count >= dict->bucket_size * WUY_DICT_EXPANSION_FACTOR
+				&& dict->bucket_size < WUY_DICT_SIZE_MAX) {
+			wuy_dict_resize(dict, dict->bucket_size * 2);
+
+		/* shrink. The load factor after shrinking is below 1/2, far
+		 * from the expansion factor, so it does not flap. */
+		} else if (dict->count < dict->bucket_size / WUY_DICT_SHRINK_FACTOR
+				&& dict->bucket_size > WUY_DICT_SIZE_INIT) {
+			wuy_dict_resize(dict, dict->bucket_size / 2);
 		}
-		dict->bucket_size *= 2;
-		dict->prev_buckets = dict->buckets;
-		dict->buckets = newb;
-		dict->split = 0;
 	}
 
-	/* split a bucket */
+	/* move a bucket */
 	if (dict->prev_buckets != NULL) {
 
 		wuy_hlist_node_t *node, *safe;
 		wuy_hlist_iter_safe(&dict->prev_buckets[dict->split], node, safe) {
-			void *item = _node_to_item(dict, node);
-			uint32_t index = wuy_dict_index_item(dict, item);
+			uint32_t index = wuy_dict_index_node(dict, node);
 			wuy_hlist_insert(&dict->buckets[index], node);
 		}
 		wuy_hlist_init(&dict->prev_buckets[dict->split]);
 		dict->split++;
-		if (dict->split == dict->bucket_size / 2) {
-			/* expansion finish */
+		if (dict->split == dict->prev_size) {
+			/* resize finish */
 			free(dict->prev_buckets);
 			dict->prev_buckets = NULL;
+			dict->prev_size = 0;
 		}
 	}
 }
 
+static void *wuy_dict_search_bucket(wuy_dict_t *dict, wuy_hlist_t *bucket,
+		const void *key, uint32_t hash)
+{
+	wuy_hlist_node_t *node;
+	wuy_hlist_iter(bucket, node) {
+		WUY_DICT_STAT_INC(dict, probes, 1);
+		if (dict->hash_cache && _node_to_hash_node(node)->hash != hash) {
+			continue;
+		}
+		void *item = _node_to_item(dict, node);
+		if (wuy_dict_equal_key(dict, item, key)) {
+			return item;
+		}
+	}
+	return NULL;
+}
+
+static wuy_hlist_t *wuy_dict_prev_bucket(wuy_dict_t *dict, uint32_t hash)
+{
+	return &dict->prev_buckets[hash & (dict->prev_size - 1)];
+}
+
 void wuy_dict_add(wuy_dict_t *dict, void *item)
 {
-	uint32_t index = wuy_dict_index_item(dict, item);
-	wuy_hlist_insert(&dict->buckets[index], _item_to_node(dict, item));
+	wuy_hlist_node_t *node = _item_to_node(dict, item);
+	uint32_t hash = wuy_dict_hash_item(dict, item);
+	if (dict->hash_cache) {
+		_node_to_hash_node(node)->hash = hash;
+	}
+
+	uint32_t index = hash & (dict->bucket_size - 1);
+
+	/* In multimap mode, insert after the existing items with the same
+	 * key, to keep them adjacent. They may be in the previous bucket
+	 * if not moved yet, and will be moved together later. */
+	if (dict->multimap) {
+		const void *key = _item_to_search_key(dict, item);
+		void *exist = wuy_dict_search_bucket(dict, &dict->buckets[index], key, hash);
+		if (exist == NULL && dict->prev_buckets != NULL) {
+			exist = wuy_dict_search_bucket(dict, wuy_dict_prev_bucket(dict, hash), key, hash);
+		}
+		if (exist != NULL) {
+			wuy_hlist_add_after(_item_to_node(dict, exist), node);
+			dict->count++;
+			wuy_dict_expasion(dict);
+			return;
+		}
+	}
+
+	wuy_hlist_insert(&dict->buckets[index], node);
 
 	dict->count++;
 	wuy_dict_expasion(dict);
@@ -230,33 +407,76 @@ void *_wuy_dict_get(wuy_dict_t *dict, const void *key)
 {
 	wuy_dict_expasion(dict);
 
-	uint32_t index = wuy_dict_index_key(dict, key);
+	uint32_t hash = wuy_dict_hash_key(dict, key);
+	uint32_t index = hash & (dict->bucket_size - 1);
 
 	/* search from dict->buckets */
-	wuy_hlist_node_t *node;
-	wuy_hlist_iter(&dict->buckets[index], node) {
-		void *item = _node_to_item(dict, node);
-		if (wuy_dict_equal_key(dict, item, key)) {
-			return item;
-		}
-	}
+	void *item = wuy_dict_search_bucket(dict, &dict->buckets[index], key, hash);
 
 	/* search from dict->prev_buckets */
-	if (dict->prev_buckets != NULL) {
-		uint32_t prev_size = dict->bucket_size / 2;
-		if (index >= prev_size) {
-			index -= prev_size;
+	if (item == NULL && dict->prev_buckets != NULL) {
+		item = wuy_dict_search_bucket(dict, wuy_dict_prev_bucket(dict, hash), key, hash);
+	}
+
+	WUY_DICT_STAT_INC(dict, gets, 1);
+	WUY_DICT_STAT_INC(dict, hits, item != NULL);
+	return item;
+}
+
+#define WUY_DICT_BATCH_CHUNK		16
+
+int wuy_dict_get_batch(wuy_dict_t *dict, const void *keys[], int n, void *out[])
+{
+	wuy_dict_expasion(dict);
+
+	/* the dict does not change during the batch, so the indexes
+	 * computed in the first pass are valid in the later passes. */
+	int found = 0;
+	for (int base = 0; base < n; base += WUY_DICT_BATCH_CHUNK) {
+		int chunk = n - base;
+		if (chunk > WUY_DICT_BATCH_CHUNK) {
+			chunk = WUY_DICT_BATCH_CHUNK;
 		}
-		wuy_hlist_iter(&dict->prev_buckets[index], node) {
-			void *item = _node_to_item(dict, node);
-			if (wuy_dict_equal_key(dict, item, key)) {
-				return item;
+
+		/* pass 1: hash keys and prefetch the buckets */
+		uint32_t hashes[WUY_DICT_BATCH_CHUNK];
+		for (int i = 0; i < chunk; i++) {
+			uint32_t hash = wuy_dict_hash_key(dict, keys[base + i]);
+			hashes[i] = hash;
+			__builtin_prefetch(&dict->buckets[hash & (dict->bucket_size - 1)]);
+		}
+
+		/* pass 2: prefetch the first nodes */
+		for (int i = 0; i < chunk; i++) {
+			uint32_t index = hashes[i] & (dict->bucket_size - 1);
+			wuy_hlist_node_t *first = dict->buckets[index].first;
+			if (first != NULL) {
+				__builtin_prefetch(first);
+			} else if (dict->prev_buckets != NULL) {
+				__builtin_prefetch(wuy_dict_prev_bucket(dict, hashes[i]));
+			}
+		}
+
+		/* pass 3: search */
+		for (int i = 0; i < chunk; i++) {
+			const void *key = keys[base + i];
+			uint32_t index = hashes[i] & (dict->bucket_size - 1);
+			void *item = wuy_dict_search_bucket(dict, &dict->buckets[index],
+					key, hashes[i]);
+			if (item == NULL && dict->prev_buckets != NULL) {
+				item = wuy_dict_search_bucket(dict, wuy_dict_prev_bucket(dict, hashes[i]),
+						key, hashes[i]);
+			}
+			out[base + i] = item;
+			if (item != NULL) {
+				found++;
 			}
 		}
 	}
 
-	/* miss */
-	return NULL;
+	WUY_DICT_STAT_INC(dict, gets, n);
+	WUY_DICT_STAT_INC(dict, hits, found);
+	return found;
 }
 
 void wuy_dict_delete(wuy_dict_t *dict, void *item)
@@ -275,6 +495,49 @@ void *_wuy_dict_del_key(wuy_dict_t *dict, const void *key)
 	return item;
 }
 
+void *_wuy_dict_get_next(wuy_dict_t *dict, void *item)
+{
+	wuy_hlist_node_t *next = _item_to_node(dict, item)->next;
+	if (next == NULL) {
+		return NULL;
+	}
+	if (dict->hash_cache && _node_to_hash_node(next)->hash
+			!= _node_to_hash_node(_item_to_node(dict, item))->hash) {
+		return NULL;
+	}
+
+	void *next_item = _node_to_item(dict, next);
+	if (!wuy_dict_equal_key(dict, next_item, _item_to_search_key(dict, item))) {
+		return NULL;
+	}
+	return next_item;
+}
+
+void *wuy_dict_get_len(wuy_dict_t *dict, const void *data, size_t len)
+{
+	wuy_dict_lstr_t ls;
+	switch (dict->key_type) {
+	case WUY_DICT_KEY_LSTRING:
+		ls.data = data;
+		ls.len = len;
+		return _wuy_dict_get(dict, &ls);
+	case WUY_DICT_KEY_BINARY:
+		return len == dict->key_len ? _wuy_dict_get(dict, data) : NULL;
+	default:
+		abort();
+	}
+}
+
+void *wuy_dict_del_len(wuy_dict_t *dict, const void *data, size_t len)
+{
+	void *item = wuy_dict_get_len(dict, data, len);
+	if (item == NULL) {
+		return NULL;
+	}
+	wuy_dict_delete(dict, item);
+	return item;
+}
+
 /*
  * Here we can not update dict->count which is used for
  * expansion, so you MUST call wuy_dict_disable_expasion()
@@ -291,6 +554,22 @@ size_t wuy_dict_count(wuy_dict_t *dict)
 	return dict->count;
 }
 
+void *wuy_dict_node_item(wuy_dict_t *dict, wuy_dict_node_t *node)
+{
+	return _node_to_item(dict, node);
+}
+
+void _wuy_dict_key_settings(wuy_dict_t *dict, wuy_dict_hash_f **key_hash,
+		wuy_dict_equal_f **key_equal, wuy_dict_key_type_e *key_type,
+		size_t *key_offset, size_t *key_len)
+{
+	*key_hash = dict->key_hash;
+	*key_equal = dict->key_equal;
+	*key_type = dict->key_type;
+	*key_offset = dict->key_offset;
+	*key_len = dict->key_len;
+}
+
 bool _wuy_dict_iter_buckets(wuy_dict_t *dict, wuy_hlist_t **start,
 		wuy_hlist_t **end)
 {
@@ -301,8 +580,61 @@ bool _wuy_dict_iter_buckets(wuy_dict_t *dict, wuy_hlist_t **start,
 	}
 	if (dict->prev_buckets != NULL && *start == dict->buckets) {
 		*start = dict->prev_buckets + dict->split;
-		*end = dict->prev_buckets + dict->bucket_size / 2;
+		*end = dict->prev_buckets + dict->prev_size;
 		return true;
 	}
 	return false;
 }
+
+static void wuy_dict_stats_buckets(wuy_dict_stats_t *stats,
+		wuy_hlist_t *start, wuy_hlist_t *end)
+{
+	for (wuy_hlist_t *bucket = start; bucket < end; bucket++) {
+		uint32_t len = 0;
+		wuy_hlist_node_t *node;
+		wuy_hlist_iter(bucket, node) {
+			len++;
+		}
+
+		if (len > stats->max_chain) {
+			stats->max_chain = len;
+		}
+		if (len > 0) {
+			stats->used_buckets++;
+		}
+		stats->histogram[len < WUY_DICT_STATS_HISTOGRAM ? len
+				: WUY_DICT_STATS_HISTOGRAM - 1]++;
+	}
+}
+
+void wuy_dict_stats(wuy_dict_t *dict, wuy_dict_stats_t *stats)
+{
+	memset(stats, 0, sizeof(wuy_dict_stats_t));
+
+	stats->count = dict->count;
+	stats->bucket_size = dict->bucket_size;
+	stats->load_factor = (double)dict->count / dict->bucket_size;
+
+	wuy_hlist_t *start = NULL, *end = NULL;
+	while (_wuy_dict_iter_buckets(dict, &start, &end)) {
+		wuy_dict_stats_buckets(stats, start, end);
+	}
+
+	/* average length of non-empty chains, which the hits walk on */
+	if (stats->used_buckets > 0) {
+		stats->avg_chain = (double)dict->count / stats->used_buckets;
+	}
+
+	if (dict->prev_buckets != NULL) {
+		stats->resizing = true;
+		stats->prev_size = dict->prev_size;
+		stats->split = dict->split;
+	}
+
+#ifdef WUY_DICT_STATS
+	stats->gets = dict->stat_gets;
+	stats->hits = dict->stat_hits;
+	stats->misses = dict->stat_gets - dict->stat_hits;
+	stats->probes = dict->stat_probes;
+#endif
+}
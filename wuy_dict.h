@@ -16,6 +16,12 @@
  * You put the key, value, and hash-node in your data struct
  * in order to use this.
  * See examples/dict.c for simple example.
+ *
+ * The dict expands when the load factor reaches 2, and shrinks when
+ * it falls below 1/4. In both cases the nodes are moved into the new
+ * buckets incrementally, one bucket at each wuy_dict_add() and
+ * wuy_dict_get(), so there is no latency spike. wuy_dict_delete()
+ * does not move nodes, so it is safe to delete during iteration.
  */
 
 #ifndef WUY_DICT_H
@@ -23,8 +29,11 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "wuy_hlist.h"
+#include "wuy_vhash.h"
 
 /**
  * @brief The dict.
@@ -43,6 +52,19 @@ typedef struct wuy_dict_s wuy_dict_t;
  */
 typedef wuy_hlist_node_t wuy_dict_node_t;
 
+/**
+ * @brief Embed this node instead of wuy_dict_node_t if you call
+ * wuy_dict_enable_hash_cache().
+ *
+ * It caches the hash value of the item's key, so the dict need not
+ * re-hash the key during expansion, and compares the hash value before
+ * comparing the key during searching.
+ */
+typedef struct {
+	wuy_hlist_node_t	hlist_node;
+	uint32_t		hash;
+} wuy_dict_hash_node_t;
+
 /**
  * @brief Return a 32 bit hash value for the key of item.
  */
@@ -63,8 +85,25 @@ typedef enum {
 	WUY_DICT_KEY_UINT64,
 	WUY_DICT_KEY_STRING,
 	WUY_DICT_KEY_POINTER,
+
+	/* The followings are supported by wuy_dict only. */
+
+	/* The key is wuy_dict_lstr_t, which need not be NUL-terminated. */
+	WUY_DICT_KEY_LSTRING,
+
+	/* The key is a fixed-size byte array in your data struct.
+	 * Use wuy_dict_new_binary() to create the dict. */
+	WUY_DICT_KEY_BINARY,
 } wuy_dict_key_type_e;
 
+/**
+ * @brief Length-delimited string, the key type of WUY_DICT_KEY_LSTRING.
+ */
+typedef struct {
+	const char	*data;
+	size_t		len;
+} wuy_dict_lstr_t;
+
 /**
  * @brief Create a dict, with the user-defined key hash/equal function.
  *
@@ -89,6 +128,17 @@ wuy_dict_t *wuy_dict_new_func(wuy_dict_hash_f *key_hash,
 wuy_dict_t *wuy_dict_new_type(wuy_dict_key_type_e key_type,
 		size_t key_offset, size_t node_offset);
 
+/**
+ * @brief Create a dict, with fixed-size binary key, WUY_DICT_KEY_BINARY.
+ *
+ * @param key_len the size of the key, e.g. 16 for IPv6 address.
+ * @param key_offset the offset of key in your data struct.
+ * @param node_offset the offset of wuy_dict_node_t in your data struct.
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_dict_t *wuy_dict_new_binary(size_t key_len, size_t key_offset, size_t node_offset);
+
 /**
  * @brief Destroy a dict.
  *
@@ -116,6 +166,48 @@ void wuy_dict_add(wuy_dict_t *dict, void *item);
 /* Used by macro wuy_dict_get. You should not use this directly. */
 void *_wuy_dict_get(wuy_dict_t *dict, const void *key);
 
+/**
+ * @brief Search items from dict by a batch of keys.
+ *
+ * This hashes all keys first, and prefetches the buckets and the first
+ * nodes, before comparing the keys. So the cache misses of the keys
+ * overlap, which is faster than calling wuy_dict_get() one by one on
+ * a big dict.
+ *
+ * Each of \b keys is same with wuy_dict_get(), so cast the integer keys
+ * to pointer by `(const void *)(uintptr_t)`.
+ *
+ * @param out the found items are stored here, or NULL if miss.
+ * @return the number of found items.
+ */
+int wuy_dict_get_batch(wuy_dict_t *dict, const void *keys[], int n, void *out[]);
+
+/**
+ * @brief Iterate over all items with the key, in multimap mode.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * It's safe to delete (but not free) the current item by
+ * wuy_dict_delete() during it, while you MUST NOT add or search
+ * this dict.
+ */
+#define wuy_dict_get_all(dict, key, item) \
+	for (item = wuy_dict_get(dict, key); item != NULL; \
+			item = _wuy_dict_get_next(dict, item))
+
+/* Used by macro wuy_dict_get_all. You should not use this directly. */
+void *_wuy_dict_get_next(wuy_dict_t *dict, void *item);
+
+/**
+ * @brief Search item from dict by the key of (data, len).
+ *
+ * This works for WUY_DICT_KEY_LSTRING and WUY_DICT_KEY_BINARY, so
+ * you need not copy and terminate the key, or build the key struct.
+ *
+ * @return the item if found, or NULL.
+ */
+void *wuy_dict_get_len(wuy_dict_t *dict, const void *data, size_t len);
+
 /**
  * @brief Delete the item from dict.
  *
@@ -140,6 +232,15 @@ void wuy_dict_delete(wuy_dict_t *dict, void *item);
 /* Used by macro wuy_dict_del_key. You should not use this directly. */
 void *_wuy_dict_del_key(wuy_dict_t *dict, const void *key);
 
+/**
+ * @brief Delete a key of (data, len) from dict.
+ *
+ * This is a combine of wuy_dict_get_len() and wuy_dict_delete().
+ *
+ * @return the item if found, or NULL.
+ */
+void *wuy_dict_del_len(wuy_dict_t *dict, const void *data, size_t len);
+
 /**
  * @brief Unlink the node from its dict, while you need not
  * know its dict.
@@ -156,6 +257,16 @@ void wuy_dict_del_node(wuy_hlist_node_t *node);
  */
 size_t wuy_dict_count(wuy_dict_t *dict);
 
+/**
+ * @brief Return the item of the node, e.g. got by wuy_dict_iter().
+ */
+void *wuy_dict_node_item(wuy_dict_t *dict, wuy_dict_node_t *node);
+
+/* internal. used by wuy_phash_new_dict(). */
+void _wuy_dict_key_settings(wuy_dict_t *dict, wuy_dict_hash_f **key_hash,
+		wuy_dict_equal_f **key_equal, wuy_dict_key_type_e *key_type,
+		size_t *key_offset, size_t *key_len);
+
 /* internal. used by wuy_dict_iter. */
 bool _wuy_dict_iter_buckets(wuy_dict_t *dict, wuy_hlist_t **start,
 		wuy_hlist_t **end);
@@ -170,12 +281,107 @@ bool _wuy_dict_iter_buckets(wuy_dict_t *dict, wuy_hlist_t **start,
 			wuy_hlist_iter(_ib, p)
 
 /**
- * @brief Disable expasion, and set the static bucket size.
+ * @brief Disable expasion and shrinking, and set the static bucket size.
  *
  * @note You MUST NOT call this after adding any node to the dict.
  */
 void wuy_dict_disable_expasion(wuy_dict_t *dict, uint32_t bucket_size);
 
+/**
+ * @brief Return the hash value of the key, the same as used inside the dict.
+ *
+ * The \b key is same with wuy_dict_get().
+ */
+#define wuy_dict_key_hash(dict, key) _wuy_dict_key_hash(dict, (const void *)(uintptr_t)key)
+
+/* Used by macro wuy_dict_key_hash. You should not use this directly. */
+uint32_t _wuy_dict_key_hash(wuy_dict_t *dict, const void *key);
+
+/**
+ * @brief Return the hash value of the item's key, the same as used inside the dict.
+ */
+uint32_t wuy_dict_item_hash(wuy_dict_t *dict, const void *item);
+
+/**
+ * @brief Cache the key's hash value in node.
+ *
+ * You MUST embed wuy_dict_hash_node_t instead of wuy_dict_node_t
+ * into your data struct, and pass its offset to wuy_dict_new_xxx().
+ *
+ * This is useful for long string keys or expensive hash functions.
+ *
+ * @note You MUST NOT call this after adding any node to the dict.
+ */
+void wuy_dict_enable_hash_cache(wuy_dict_t *dict);
+
+/**
+ * @brief Allow multiple items with the same key, i.e. multimap.
+ *
+ * The items with the same key are kept adjacent in the chain, so
+ * wuy_dict_get_all() iterates over them without scanning others.
+ * wuy_dict_get() returns the first one.
+ *
+ * Adding is slower because it searches the existing key first.
+ *
+ * @note You MUST NOT call this after adding any node to the dict.
+ */
+void wuy_dict_enable_multimap(wuy_dict_t *dict);
+
+/**
+ * @brief Use keyed hash function with a random key for this dict.
+ *
+ * The dict hashes the keys by SipHash-1-3, with a 128-bit random key
+ * generated for each dict. So the attackers can not craft keys which
+ * collide, e.g. in request headers or query arguments.
+ *
+ * This works for the dict created by wuy_dict_new_type() and
+ * wuy_dict_new_binary() only.
+ *
+ * The key is read from getrandom(), or /dev/urandom on old kernels.
+ * It aborts the program if neither works.
+ *
+ * @note You MUST NOT call this after adding any node to the dict.
+ */
+void wuy_dict_enable_keyed_hash(wuy_dict_t *dict);
+
+#define WUY_DICT_STATS_HISTOGRAM	8
+
+/**
+ * @brief Statistics of a dict, got by wuy_dict_stats().
+ */
+typedef struct {
+	size_t		count;
+	uint32_t	bucket_size;
+	double		load_factor;
+
+	/* if the buckets are expanding or shrinking */
+	bool		resizing;
+	uint32_t	prev_size;
+	uint32_t	split;
+
+	/* chains */
+	uint32_t	used_buckets;
+	uint32_t	max_chain;
+	double		avg_chain; /* of non-empty chains */
+
+	/* number of buckets with chain length 0, 1, ..., and the last
+	 * one for the longer chains */
+	size_t		histogram[WUY_DICT_STATS_HISTOGRAM];
+
+	/* counters of searching, only if compiled with WUY_DICT_STATS */
+	uint64_t	gets;
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	probes; /* nodes visited */
+} wuy_dict_stats_t;
+
+/**
+ * @brief Get the statistics of the dict.
+ *
+ * This walks all buckets, so do not call it frequently on big dict.
+ */
+void wuy_dict_stats(wuy_dict_t *dict, wuy_dict_stats_t *stats);
+
 /**
  * @brief BKDRHash, a simple string hash
  */
@@ -201,6 +407,15 @@ static inline uint32_t wuy_dict_hash_lenstr(const char *str, int len)
 	return hash;
 }
 
+/**
+ * @brief Hash for binary data, with length.
+ */
+static inline uint32_t wuy_dict_hash_binary(const void *data, size_t len)
+{
+	uint64_t hash = wuy_vhash64(data, len);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
 /**
  * @brief a simple pointer hash.
  * In Knuth's "The Art of Computer Programming", section 6.4
@@ -211,4 +426,148 @@ static inline uint32_t wuy_dict_hash_pointer(const void *p)
 	return (uint32_t)(n >> 4) * 2654435761;
 }
 
+/*
+ * internal. The hash and comparison of the general key types, shared
+ * by wuy_dict, wuy_oadict, wuy_rcudict, wuy_nop_dict and wuy_phash, so
+ * that all of them treat the keys in the same way.
+ *
+ * The key is in the form of wuy_dict_get(), while item_key points to
+ * the key in the item. The key_len is used by WUY_DICT_KEY_BINARY only.
+ */
+static inline uint32_t _wuy_dict_type_hash_key(wuy_dict_key_type_e key_type,
+		size_t key_len, const void *key)
+{
+	uint64_t n;
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		return (uint32_t)(uintptr_t)key;
+	case WUY_DICT_KEY_UINT64:
+		n = (uint64_t)(uintptr_t)key;
+		return (uint32_t)(n ^ (n >> 32));
+	case WUY_DICT_KEY_STRING:
+		return wuy_dict_hash_string(key);
+	case WUY_DICT_KEY_POINTER:
+		return wuy_dict_hash_pointer(key);
+	case WUY_DICT_KEY_LSTRING:
+		return wuy_dict_hash_binary(((const wuy_dict_lstr_t *)key)->data,
+				((const wuy_dict_lstr_t *)key)->len);
+	case WUY_DICT_KEY_BINARY:
+		return wuy_dict_hash_binary(key, key_len);
+	default:
+		abort();
+	}
+}
+static inline uint32_t _wuy_dict_type_hash_item_key(wuy_dict_key_type_e key_type,
+		size_t key_len, const void *item_key)
+{
+	uint64_t n;
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		return *(const uint32_t *)item_key;
+	case WUY_DICT_KEY_UINT64:
+		n = *(const uint64_t *)item_key;
+		return (uint32_t)(n ^ (n >> 32));
+	case WUY_DICT_KEY_STRING:
+		return wuy_dict_hash_string(*(const char **)item_key);
+	case WUY_DICT_KEY_POINTER:
+		return wuy_dict_hash_pointer(*(const char **)item_key);
+	case WUY_DICT_KEY_LSTRING:
+		return wuy_dict_hash_binary(((const wuy_dict_lstr_t *)item_key)->data,
+				((const wuy_dict_lstr_t *)item_key)->len);
+	case WUY_DICT_KEY_BINARY:
+		return wuy_dict_hash_binary(item_key, key_len);
+	default:
+		abort();
+	}
+}
+static inline bool _wuy_dict_type_equal_key(wuy_dict_key_type_e key_type,
+		size_t key_len, const void *item_key, const void *key)
+{
+	const wuy_dict_lstr_t *ls1, *ls2;
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		return *(const uint32_t *)item_key == (uint32_t)(uintptr_t)key;
+	case WUY_DICT_KEY_UINT64:
+		return *(const uint64_t *)item_key == (uint64_t)(uintptr_t)key;
+	case WUY_DICT_KEY_STRING:
+		return strcmp(*(const char **)item_key, key) == 0;
+	case WUY_DICT_KEY_POINTER:
+		return *(const uintptr_t *)item_key == (uintptr_t)key;
+	case WUY_DICT_KEY_LSTRING:
+		ls1 = item_key;
+		ls2 = key;
+		return ls1->len == ls2->len && memcmp(ls1->data, ls2->data, ls1->len) == 0;
+	case WUY_DICT_KEY_BINARY:
+		return memcmp(item_key, key, key_len) == 0;
+	default:
+		abort();
+	}
+}
+
+/*
+ * internal. Return the bytes of key, for the hash functions on data,
+ * e.g. the keyed hash. The integer key is stored in buf.
+ */
+static inline const void *_wuy_dict_type_key_data(wuy_dict_key_type_e key_type,
+		size_t key_len, const void *key, uint64_t *buf, size_t *len)
+{
+	const wuy_dict_lstr_t *ls;
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		*(uint32_t *)buf = (uint32_t)(uintptr_t)key;
+		*len = sizeof(uint32_t);
+		return buf;
+	case WUY_DICT_KEY_UINT64:
+		*buf = (uint64_t)(uintptr_t)key;
+		*len = sizeof(uint64_t);
+		return buf;
+	case WUY_DICT_KEY_STRING:
+		*len = strlen(key);
+		return key;
+	case WUY_DICT_KEY_POINTER:
+		*buf = (uintptr_t)key;
+		*len = sizeof(const void *);
+		return buf;
+	case WUY_DICT_KEY_LSTRING:
+		ls = key;
+		*len = ls->len;
+		return ls->data;
+	case WUY_DICT_KEY_BINARY:
+		*len = key_len;
+		return key;
+	default:
+		abort();
+	}
+}
+static inline const void *_wuy_dict_type_item_key_data(wuy_dict_key_type_e key_type,
+		size_t key_len, const void *item_key, size_t *len)
+{
+	const char *str;
+	const wuy_dict_lstr_t *ls;
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		*len = sizeof(uint32_t);
+		return item_key;
+	case WUY_DICT_KEY_UINT64:
+		*len = sizeof(uint64_t);
+		return item_key;
+	case WUY_DICT_KEY_STRING:
+		str = *(const char **)item_key;
+		*len = strlen(str);
+		return str;
+	case WUY_DICT_KEY_POINTER:
+		*len = sizeof(const void *);
+		return item_key;
+	case WUY_DICT_KEY_LSTRING:
+		ls = item_key;
+		*len = ls->len;
+		return ls->data;
+	case WUY_DICT_KEY_BINARY:
+		*len = key_len;
+		return item_key;
+	default:
+		abort();
+	}
+}
+
 #endif
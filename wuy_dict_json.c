@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wuy_dict_json.h"
+
+void wuy_dict_stats_json(const wuy_dict_stats_t *stats, wuy_json_t *json)
+{
+	wuy_json_object_uint(json, "count", stats->count);
+	wuy_json_object_uint(json, "bucket_size", stats->bucket_size);
+	wuy_json_object_double(json, "load_factor", stats->load_factor);
+	wuy_json_object_bool(json, "resizing", stats->resizing);
+	if (stats->resizing) {
+		wuy_json_object_uint(json, "prev_size", stats->prev_size);
+		wuy_json_object_uint(json, "split", stats->split);
+	}
+	wuy_json_object_uint(json, "used_buckets", stats->used_buckets);
+	wuy_json_object_uint(json, "max_chain", stats->max_chain);
+	wuy_json_object_double(json, "avg_chain", stats->avg_chain);
+
+	wuy_json_object_array(json, "histogram");
+	for (int i = 0; i < WUY_DICT_STATS_HISTOGRAM; i++) {
+		wuy_json_array_uint(json, stats->histogram[i]);
+	}
+	wuy_json_array_close(json);
+
+#ifdef WUY_DICT_STATS
+	wuy_json_object_uint(json, "gets", stats->gets);
+	wuy_json_object_uint(json, "hits", stats->hits);
+	wuy_json_object_uint(json, "misses", stats->misses);
+	wuy_json_object_uint(json, "probes", stats->probes);
+#endif
+}
@@ -0,0 +1,26 @@
+/**
+ * @file     wuy_dict_json.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-28
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * Dump the statistics of wuy_dict by wuy_json. It's apart from
+ * wuy_dict.h, so the dict users need not depend on wuy_json.
+ */
+
+#ifndef WUY_DICT_JSON_H
+#define WUY_DICT_JSON_H
+
+#include "wuy_dict.h"
+#include "wuy_json.h"
+
+/**
+ * @brief Dump the statistics into current object of json.
+ */
+void wuy_dict_stats_json(const wuy_dict_stats_t *stats, wuy_json_t *json);
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "wuy_nop_hlist.h"
+#include "wuy_dict_snap.h"
+
+/*
+ * File layout, all offsets are relative to the file start:
+ *
+ *   struct wuy_dict_snap_header
+ *   wuy_nop_hlist_t buckets[bucket_size]
+ *   entries[count], each is struct wuy_dict_snap_entry and the item,
+ *                   aligned to 8 bytes
+ *
+ * Offset 0 is the header, so it means NULL in wuy_nop_hlist.
+ */
+#define WUY_DICT_SNAP_MAGIC	"WUYDSNP"
+#define WUY_DICT_SNAP_VERSION	1
+
+struct wuy_dict_snap_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	key_type;
+	uint32_t	key_offset;
+	uint32_t	key_len;
+	uint32_t	item_size;
+	uint32_t	entry_size;
+	uint32_t	bucket_size;
+	uint32_t	count;
+	uint64_t	file_size;
+};
+
+struct wuy_dict_snap_entry {
+	wuy_nop_hlist_node_t	node;
+	uint32_t		hash;
+	uint32_t		pad;
+};
+
+struct wuy_dict_snap_s {
+	const char				*base;
+	size_t					size;
+	const struct wuy_dict_snap_header	*header;
+	const wuy_nop_hlist_t			*buckets;
+};
+
+#define WUY_DICT_SNAP_ALIGN(n)	(((n) + 7) & ~(size_t)7)
+
+/* The hash is saved in file, so it must not change between processes.
+ * So the dict's hash (which may be keyed) is not used here. */
+static uint32_t wuy_dict_snap_hash(uint32_t key_type, uint32_t key_len, const void *key_data)
+{
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		return wuy_dict_hash_binary(key_data, sizeof(uint32_t));
+	case WUY_DICT_KEY_UINT64:
+		return wuy_dict_hash_binary(key_data, sizeof(uint64_t));
+	case WUY_DICT_KEY_BINARY:
+		return wuy_dict_hash_binary(key_data, key_len);
+	default:
+		abort();
+	}
+}
+
+static uint32_t wuy_dict_snap_key_len(uint32_t key_type, uint32_t key_len)
+{
+	switch (key_type) {
+	case WUY_DICT_KEY_UINT32:
+		return sizeof(uint32_t);
+	case WUY_DICT_KEY_UINT64:
+		return sizeof(uint64_t);
+	default:
+		return key_len;
+	}
+}
+
+static int wuy_dict_snap_write_file(const char *path, const char *buf, size_t size)
+{
+	char tmp_path[strlen(path) + 10];
+	sprintf(tmp_path, "%s.tmp", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+
+	size_t pos = 0;
+	while (pos < size) {
+		ssize_t n = write(fd, buf + pos, size - pos);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			goto fail;
+		}
+		pos += n;
+	}
+	if (fsync(fd) < 0) {
+		goto fail;
+	}
+	close(fd);
+
+	if (rename(tmp_path, path) < 0) {
+		unlink(tmp_path);
+		return -1;
+	}
+	return 0;
+
+fail:;
+	int err = errno;
+	close(fd);
+	unlink(tmp_path);
+	errno = err;
+	return -1;
+}
+
+int wuy_dict_snap_save(wuy_dict_t *dict, size_t item_size, const char *path)
+{
+	wuy_dict_hash_f *key_hash;
+	wuy_dict_equal_f *key_equal;
+	wuy_dict_key_type_e key_type;
+	size_t key_offset, key_len;
+	_wuy_dict_key_settings(dict, &key_hash, &key_equal, &key_type,
+			&key_offset, &key_len);
+
+	if (key_hash != NULL || (key_type != WUY_DICT_KEY_UINT32
+			&& key_type != WUY_DICT_KEY_UINT64
+			&& key_type != WUY_DICT_KEY_BINARY)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t count = wuy_dict_count(dict);
+	uint32_t bucket_size = 1;
+	while (bucket_size < count) {
+		bucket_size <<= 1;
+	}
+
+	size_t entry_size = WUY_DICT_SNAP_ALIGN(sizeof(struct wuy_dict_snap_entry) + item_size);
+	size_t entries_offset = WUY_DICT_SNAP_ALIGN(sizeof(struct wuy_dict_snap_header)
+			+ sizeof(wuy_nop_hlist_t) * bucket_size);
+	size_t file_size = entries_offset + entry_size * count;
+
+	/* wuy_nop_hlist_addr_t is 32-bit */
+	if (file_size > UINT32_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	char *buf = calloc(1, file_size);
+	if (buf == NULL) {
+		return -1;
+	}
+
+	struct wuy_dict_snap_header *header = (struct wuy_dict_snap_header *)buf;
+	memcpy(header->magic, WUY_DICT_SNAP_MAGIC, sizeof(header->magic));
+	header->version = WUY_DICT_SNAP_VERSION;
+	header->key_type = key_type;
+	header->key_offset = key_offset;
+	header->key_len = wuy_dict_snap_key_len(key_type, key_len);
+	header->item_size = item_size;
+	header->entry_size = entry_size;
+	header->bucket_size = bucket_size;
+	header->count = count;
+	header->file_size = file_size;
+
+	wuy_nop_hlist_t *buckets = (wuy_nop_hlist_t *)(header + 1);
+	for (uint32_t i = 0; i < bucket_size; i++) {
+		wuy_nop_hlist_init(&buckets[i]);
+	}
+
+	char *pos = buf + entries_offset;
+	wuy_hlist_node_t *node;
+	wuy_dict_iter(dict, node) {
+		const char *item = wuy_dict_node_item(dict, node);
+		struct wuy_dict_snap_entry *entry = (struct wuy_dict_snap_entry *)pos;
+		memcpy(entry + 1, item, item_size);
+
+		entry->hash = wuy_dict_snap_hash(key_type, header->key_len, item + key_offset);
+		wuy_nop_hlist_insert(&buckets[entry->hash & (bucket_size - 1)],
+				&entry->node, buf);
+		pos += entry_size;
+	}
+	assert(pos == buf + file_size);
+
+	int ret = wuy_dict_snap_write_file(path, buf, file_size);
+	int err = errno;
+	free(buf);
+	errno = err;
+	return ret;
+}
+
+static bool wuy_dict_snap_check(const struct wuy_dict_snap_header *header, size_t size)
+{
+	if (size < sizeof(struct wuy_dict_snap_header)) {
+		return false;
+	}
+	if (memcmp(header->magic, WUY_DICT_SNAP_MAGIC, sizeof(header->magic)) != 0) {
+		return false;
+	}
+	if (header->version != WUY_DICT_SNAP_VERSION || header->file_size != size) {
+		return false;
+	}
+	if (header->key_type != WUY_DICT_KEY_UINT32 && header->key_type != WUY_DICT_KEY_UINT64
+			&& header->key_type != WUY_DICT_KEY_BINARY) {
+		return false;
+	}
+	if (header->bucket_size == 0 || (header->bucket_size & (header->bucket_size - 1)) != 0) {
+		return false;
+	}
+	if ((uint64_t)header->key_offset + header->key_len > header->item_size) {
+		return false;
+	}
+
+	uint64_t entries_offset = WUY_DICT_SNAP_ALIGN(sizeof(struct wuy_dict_snap_header)
+			+ sizeof(wuy_nop_hlist_t) * (uint64_t)header->bucket_size);
+	return entries_offset + (uint64_t)header->entry_size * header->count == size;
+}
+
+wuy_dict_snap_t *wuy_dict_snap_load(const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size < sizeof(struct wuy_dict_snap_header)) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		return NULL;
+	}
+
+	if (!wuy_dict_snap_check(base, st.st_size)) {
+		munmap(base, st.st_size);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	wuy_dict_snap_t *snap = malloc(sizeof(wuy_dict_snap_t));
+	assert(snap != NULL);
+	snap->base = base;
+	snap->size = st.st_size;
+	snap->header = base;
+	snap->buckets = (const wuy_nop_hlist_t *)(snap->header + 1);
+	return snap;
+}
+
+void wuy_dict_snap_close(wuy_dict_snap_t *snap)
+{
+	munmap((void *)snap->base, snap->size);
+	free(snap);
+}
+
+static const void *wuy_dict_snap_search(wuy_dict_snap_t *snap, const void *key_data)
+{
+	const struct wuy_dict_snap_header *header = snap->header;
+	uint32_t hash = wuy_dict_snap_hash(header->key_type, header->key_len, key_data);
+	const wuy_nop_hlist_t *bucket = &snap->buckets[hash & (header->bucket_size - 1)];
+
+	wuy_nop_hlist_node_t *node;
+	wuy_nop_hlist_iter(bucket, node, (void *)snap->base) {
+		const struct wuy_dict_snap_entry *entry = wuy_containerof(node,
+				struct wuy_dict_snap_entry, node);
+		if (entry->hash != hash) {
+			continue;
+		}
+		const char *item = (const char *)(entry + 1);
+		if (memcmp(item + header->key_offset, key_data, header->key_len) == 0) {
+			return item;
+		}
+	}
+	return NULL;
+}
+
+const void *_wuy_dict_snap_get(wuy_dict_snap_t *snap, const void *key)
+{
+	uint32_t n32;
+	uint64_t n64;
+	switch (snap->header->key_type) {
+	case WUY_DICT_KEY_UINT32:
+		n32 = (uint32_t)(uintptr_t)key;
+		return wuy_dict_snap_search(snap, &n32);
+	case WUY_DICT_KEY_UINT64:
+		n64 = (uint64_t)(uintptr_t)key;
+		return wuy_dict_snap_search(snap, &n64);
+	case WUY_DICT_KEY_BINARY:
+		return wuy_dict_snap_search(snap, key);
+	default:
+		abort();
+	}
+}
+
+const void *wuy_dict_snap_get_len(wuy_dict_snap_t *snap, const void *data, size_t len)
+{
+	assert(snap->header->key_type == WUY_DICT_KEY_BINARY);
+	return len == snap->header->key_len ? wuy_dict_snap_search(snap, data) : NULL;
+}
+
+size_t wuy_dict_snap_count(wuy_dict_snap_t *snap)
+{
+	return snap->header->count;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file     wuy_dict_snap.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-29
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * Snapshot of wuy_dict into a file, for fast warm restart.
+ *
+ * wuy_dict_snap_save() copies all items of a dict into a file, with
+ * buckets linked by wuy_nop_hlist.h which uses relative offset as
+ * pointer. wuy_dict_snap_load() maps the file read-only, and the
+ * searching works on the mapping directly. So there is no rebuilding
+ * after restart, and the pages are loaded lazily by page faults.
+ *
+ * The items are copied byte by byte, so they must be fixed-size and
+ * must not contain pointers, which are invalid in the snapshot,
+ * except the embedded wuy_dict_node_t which is just ignored.
+ * For the same reason, only WUY_DICT_KEY_UINT32, WUY_DICT_KEY_UINT64
+ * and WUY_DICT_KEY_BINARY are supported.
+ *
+ * The snapshot file is not portable between machines with different
+ * byte-order.
+ */
+
+#ifndef WUY_DICT_SNAP_H
+#define WUY_DICT_SNAP_H
+
+#include <stdint.h>
+
+#include "wuy_dict.h"
+
+/**
+ * @brief The loaded snapshot.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_dict_snap_s wuy_dict_snap_t;
+
+/**
+ * @brief Save all items in dict into the file.
+ *
+ * The file is written into a temporary file and renamed to \b path
+ * at last, so the loaders never see a partial file.
+ *
+ * @param item_size the size of your data struct.
+ *
+ * @return 0 if success, or -1 with errno set. EINVAL means the dict's
+ * key type is not supported or the snapshot is too big (>4GB).
+ */
+int wuy_dict_snap_save(wuy_dict_t *dict, size_t item_size, const char *path);
+
+/**
+ * @brief Map a snapshot file read-only.
+ *
+ * The file is validated by the header only, so do not load an
+ * untrusted file.
+ *
+ * @return the snapshot, or NULL with errno set if fails.
+ */
+wuy_dict_snap_t *wuy_dict_snap_load(const char *path);
+
+/**
+ * @brief Unmap the snapshot. The items got from it are invalid then.
+ */
+void wuy_dict_snap_close(wuy_dict_snap_t *snap);
+
+/**
+ * @brief Search item from snapshot by the key.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @return the item in the mapping if found, or NULL. It is read-only.
+ */
+#define wuy_dict_snap_get(snap, key) _wuy_dict_snap_get(snap, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_dict_snap_get. You should not use this directly. */
+const void *_wuy_dict_snap_get(wuy_dict_snap_t *snap, const void *key);
+
+/**
+ * @brief Search item from snapshot by the key of (data, len),
+ * for WUY_DICT_KEY_BINARY.
+ *
+ * @return the item in the mapping if found, or NULL. It is read-only.
+ */
+const void *wuy_dict_snap_get_len(wuy_dict_snap_t *snap, const void *data, size_t len);
+
+/**
+ * @brief Return the count of items in snapshot.
+ */
+size_t wuy_dict_snap_count(wuy_dict_snap_t *snap);
+
+#endif
@@ -5,6 +5,13 @@
 
 #include "wuy_heap.h"
 
+/* cached key, for the numeric key types only */
+typedef union {
+	int64_t		i;
+	uint64_t	u;
+	double		d;
+} wuy_heap_key_t;
+
 struct wuy_heap_s {
 	wuy_heap_key_type_e	key_type;
 	wuy_heap_less_f		*key_less;
@@ -15,6 +22,12 @@ struct wuy_heap_s {
 	size_t			capture;
 	size_t			count;
 
+	size_t			arity;
+
+	/* copies of the keys, parallel with array, if key_cache */
+	bool			key_cache;
+	wuy_heap_key_t		*keys;
+
 	wuy_heap_update_f	*key_update;
 
 	size_t			node_offset;
@@ -22,6 +35,10 @@ struct wuy_heap_s {
 
 #define WUY_HEAP_SIZE_INIT 1024
 
+/* wuy_heap_push_many() heapifies the whole heap if the batch
+ * is bigger than 1/WUY_HEAP_BULK_RATIO of the heap */
+#define WUY_HEAP_BULK_RATIO 8
+
 static wuy_heap_t *wuy_heap_new(size_t node_offset)
 {
 	wuy_heap_t *heap = malloc(sizeof(wuy_heap_t));
@@ -33,6 +50,11 @@ static wuy_heap_t *wuy_heap_new(size_t node_offset)
 
 	heap->count = 0;
 	heap->node_offset = node_offset;
+	heap->arity = 2;
+	heap->key_cache = false;
+	heap->keys = NULL;
+	heap->key_update = NULL;
+	heap->key_reverse = false;
 	return heap;
 }
 
@@ -56,6 +78,30 @@ wuy_heap_t *wuy_heap_new_type(wuy_heap_key_type_e key_type, size_t key_offset,
 	return heap;
 }
 
+void wuy_heap_destroy(wuy_heap_t *heap)
+{
+	free(heap->keys);
+	free(heap->array);
+	free(heap);
+}
+
+void wuy_heap_set_arity(wuy_heap_t *heap, size_t arity)
+{
+	assert(heap->count == 0);
+	assert(arity >= 2);
+	heap->arity = arity;
+}
+
+void wuy_heap_enable_key_cache(wuy_heap_t *heap)
+{
+	assert(heap->count == 0);
+	assert(heap->key_less == NULL && heap->key_type != WUY_HEAP_KEY_STRING);
+
+	heap->key_cache = true;
+	heap->keys = malloc(sizeof(wuy_heap_key_t) * heap->capture);
+	assert(heap->keys != NULL);
+}
+
 static wuy_heap_node_t *_item_to_node(wuy_heap_t *heap, const void *item)
 {
 	return (wuy_heap_node_t *)((char *)item + heap->node_offset);
@@ -77,35 +123,91 @@ void * _wuy_heap_item(wuy_heap_t *heap, size_t i)
 	return _index_to_item(heap, i);
 }
 
-static bool wuy_heap_less(wuy_heap_t *heap, size_t i, size_t j)
+static void wuy_heap_load_key(wuy_heap_t *heap, size_t i)
+{
+	void *pk = _index_to_key(heap, i);
+	wuy_heap_key_t *key = &heap->keys[i];
+
+	switch (heap->key_type) {
+	case WUY_HEAP_KEY_INT32:
+		key->i = *(int32_t *)pk;
+		break;
+	case WUY_HEAP_KEY_UINT32:
+		key->u = *(uint32_t *)pk;
+		break;
+	case WUY_HEAP_KEY_INT64:
+		key->i = *(int64_t *)pk;
+		break;
+	case WUY_HEAP_KEY_UINT64:
+		key->u = *(uint64_t *)pk;
+		break;
+	case WUY_HEAP_KEY_FLOAT:
+		key->d = *(float *)pk;
+		break;
+	case WUY_HEAP_KEY_DOUBLE:
+		key->d = *(double *)pk;
+		break;
+	default:
+		abort();
+	}
+}
+
+static bool wuy_heap_less_cached(wuy_heap_t *heap, size_t i, size_t j)
+{
+	wuy_heap_key_t *ki = &heap->keys[i];
+	wuy_heap_key_t *kj = &heap->keys[j];
+
+	bool ret;
+
+	switch (heap->key_type) {
+	case WUY_HEAP_KEY_INT32:
+	case WUY_HEAP_KEY_INT64:
+		ret = ki->i < kj->i;
+		break;
+	case WUY_HEAP_KEY_UINT32:
+	case WUY_HEAP_KEY_UINT64:
+		ret = ki->u < kj->u;
+		break;
+	case WUY_HEAP_KEY_FLOAT:
+	case WUY_HEAP_KEY_DOUBLE:
+		ret = ki->d < kj->d;
+		break;
+	default:
+		abort();
+	}
+
+	return heap->key_reverse ? !ret : ret;
+}
+
+static bool wuy_heap_less_items(wuy_heap_t *heap, const void *a, const void *b)
 {
 	if (heap->key_less != NULL) {
-		return heap->key_less(_index_to_item(heap, i), _index_to_item(heap, j));
+		return heap->key_less(a, b);
 	}
 
-	void *pki = _index_to_key(heap, i);
-	void *pkj = _index_to_key(heap, j);
+	const char *pki = (const char *)a + heap->key_offset;
+	const char *pkj = (const char *)b + heap->key_offset;
 
 	bool ret;
 
 	switch (heap->key_type) {
 	case WUY_HEAP_KEY_INT32:
-		ret = *(int32_t *)pki < *(int32_t *)pkj;
+		ret = *(const int32_t *)pki < *(const int32_t *)pkj;
 		break;
 	case WUY_HEAP_KEY_UINT32:
-		ret = *(uint32_t *)pki < *(uint32_t *)pkj;
+		ret = *(const uint32_t *)pki < *(const uint32_t *)pkj;
 		break;
 	case WUY_HEAP_KEY_INT64:
-		ret = *(int64_t *)pki < *(int64_t *)pkj;
+		ret = *(const int64_t *)pki < *(const int64_t *)pkj;
 		break;
 	case WUY_HEAP_KEY_UINT64:
-		ret = *(uint64_t *)pki < *(uint64_t *)pkj;
+		ret = *(const uint64_t *)pki < *(const uint64_t *)pkj;
 		break;
 	case WUY_HEAP_KEY_FLOAT:
-		ret = *(float *)pki < *(float *)pkj;
+		ret = *(const float *)pki < *(const float *)pkj;
 		break;
 	case WUY_HEAP_KEY_DOUBLE:
-		ret = *(double *)pki < *(double *)pkj;
+		ret = *(const double *)pki < *(const double *)pkj;
 		break;
 	case WUY_HEAP_KEY_STRING:
 		ret = strcmp(pki, pkj) < 0;
@@ -117,6 +219,19 @@ static bool wuy_heap_less(wuy_heap_t *heap, size_t i, size_t j)
 	return heap->key_reverse ? !ret : ret;
 }
 
+static bool wuy_heap_less(wuy_heap_t *heap, size_t i, size_t j)
+{
+	if (heap->key_cache) {
+		return wuy_heap_less_cached(heap, i, j);
+	}
+	return wuy_heap_less_items(heap, _index_to_item(heap, i), _index_to_item(heap, j));
+}
+
+bool wuy_heap_less_item(wuy_heap_t *heap, const void *a, const void *b)
+{
+	return wuy_heap_less_items(heap, a, b);
+}
+
 static void wuy_heap_swap(wuy_heap_t *heap, size_t i, size_t j)
 {
 	wuy_heap_node_t *tmp = heap->array[i];
@@ -125,12 +240,18 @@ static void wuy_heap_swap(wuy_heap_t *heap, size_t i, size_t j)
 
 	heap->array[i]->index = i;
 	heap->array[j]->index = j;
+
+	if (heap->key_cache) {
+		wuy_heap_key_t tmpk = heap->keys[i];
+		heap->keys[i] = heap->keys[j];
+		heap->keys[j] = tmpk;
+	}
 }
 
 static void wuy_heapify_up(wuy_heap_t *heap, size_t i)
 {
 	while (i > 0) {
-		size_t parent = (i - 1) / 2;
+		size_t parent = (i - 1) / heap->arity;
 		if (parent == i || !wuy_heap_less(heap, i, parent)) {
 			break;
 		}
@@ -142,15 +263,18 @@ static void wuy_heapify_up(wuy_heap_t *heap, size_t i)
 static void wuy_heapify_down(wuy_heap_t *heap, size_t i)
 {
 	while (1) {
-		size_t left = i * 2 + 1;
-		size_t right = left + 1;
-		size_t swap = i;
-
-		if (left < heap->count && wuy_heap_less(heap, left, swap)) {
-			swap = left;
+		size_t first = i * heap->arity + 1;
+		size_t last = first + heap->arity;
+		if (last > heap->count) {
+			last = heap->count;
 		}
-		if (right < heap->count && wuy_heap_less(heap, right, swap)) {
-			swap = right;
+
+		/* the children are adjacent, and so are their cached keys */
+		size_t swap = i;
+		for (size_t c = first; c < last; c++) {
+			if (wuy_heap_less(heap, c, swap)) {
+				swap = c;
+			}
 		}
 		if (swap == i) {
 			break;
@@ -166,27 +290,53 @@ bool wuy_heap_is_linked(wuy_heap_t *heap, wuy_heap_node_t *node)
 	return (index < heap->count && heap->array[index] == node);
 }
 
-bool wuy_heap_push_node(wuy_heap_t *heap, wuy_heap_node_t *node)
+static bool wuy_heap_resize(wuy_heap_t *heap, size_t capture)
 {
-	if (heap->count >= heap->capture) {
-		void *olda = heap->array;
-		size_t oldc = heap->capture;
-
-		heap->capture *= 2;
-		heap->array = realloc(heap->array, heap->capture);
-		if (heap->array == NULL) {
-			heap->capture = oldc + WUY_HEAP_SIZE_INIT;
-			heap->array = realloc(heap->array, heap->capture);
-			if (heap->array == NULL) { /* roll back */
-				heap->array = olda;
-				heap->capture = oldc;
-				return false;
-			}
+	wuy_heap_node_t **array = realloc(heap->array, sizeof(wuy_heap_node_t *) * capture);
+	if (array == NULL) {
+		return false;
+	}
+	heap->array = array;
+
+	if (heap->key_cache) {
+		wuy_heap_key_t *keys = realloc(heap->keys, sizeof(wuy_heap_key_t) * capture);
+		if (keys == NULL) {
+			/* the array is bigger than capture, which is OK */
+			return false;
 		}
+		heap->keys = keys;
+	}
+
+	heap->capture = capture;
+	return true;
+}
+
+static bool wuy_heap_grow(wuy_heap_t *heap, size_t n)
+{
+	size_t need = heap->count + n;
+	if (need <= heap->capture) {
+		return true;
+	}
+
+	size_t capture = heap->capture * 2;
+	while (capture < need) {
+		capture *= 2;
+	}
+	return wuy_heap_resize(heap, capture)
+		|| wuy_heap_resize(heap, need + WUY_HEAP_SIZE_INIT);
+}
+
+bool wuy_heap_push_node(wuy_heap_t *heap, wuy_heap_node_t *node)
+{
+	if (!wuy_heap_grow(heap, 1)) {
+		return false;
 	}
 
 	heap->array[heap->count] = node;
 	node->index = heap->count;
+	if (heap->key_cache) {
+		wuy_heap_load_key(heap, heap->count);
+	}
 
 	wuy_heapify_up(heap, heap->count);
 	heap->count++;
@@ -205,7 +355,11 @@ static void wuy_heap_fix_node(wuy_heap_t *heap, wuy_heap_node_t *node)
 {
 	size_t index = node->index;
 
-	if (index > 0 && wuy_heap_less(heap, index, (index - 1) / 2)) {
+	if (heap->key_cache) {
+		wuy_heap_load_key(heap, index);
+	}
+
+	if (index > 0 && wuy_heap_less(heap, index, (index - 1) / heap->arity)) {
 		wuy_heapify_up(heap, index);
 	} else {
 		wuy_heapify_down(heap, index);
@@ -236,22 +390,68 @@ void wuy_heap_set_rebuild_update(wuy_heap_t *heap, wuy_heap_update_f *f)
 {
 	heap->key_update = f;
 }
+/* Floyd's bottom-up construction, sift down every non-leaf node from
+ * the last one. It's O(n) in total, since most nodes are near bottom. */
+static void wuy_heap_heapify_all(wuy_heap_t *heap)
+{
+	if (heap->count < 2) {
+		return;
+	}
+	for (size_t i = (heap->count - 2) / heap->arity + 1; i > 0; i--) {
+		wuy_heapify_down(heap, i - 1);
+	}
+}
+
 void wuy_heap_rebuild(wuy_heap_t *heap)
 {
 	for (size_t i = 0; i < heap->count; i++) {
 		if (heap->key_update != NULL) {
 			heap->key_update(_index_to_item(heap, i));
 		}
-		wuy_heapify_up(heap, i);
+		if (heap->key_cache) {
+			wuy_heap_load_key(heap, i);
+		}
+	}
+	wuy_heap_heapify_all(heap);
+}
+
+bool wuy_heap_push_many(wuy_heap_t *heap, void *const items[], size_t n)
+{
+	if (!wuy_heap_grow(heap, n)) {
+		return false;
+	}
+
+	/* pushing one by one costs O(n*log(count)), while appending and
+	 * heapifying costs O(count+n). */
+	if (n < heap->count / WUY_HEAP_BULK_RATIO) {
+		for (size_t i = 0; i < n; i++) {
+			wuy_heap_push(heap, items[i]);
+		}
+		return true;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		wuy_heap_node_t *node = _item_to_node(heap, items[i]);
+		assert(!wuy_heap_is_linked(heap, node));
+
+		heap->array[heap->count] = node;
+		node->index = heap->count;
+		if (heap->key_cache) {
+			wuy_heap_load_key(heap, heap->count);
+		}
+		heap->count++;
 	}
+	wuy_heap_heapify_all(heap);
+	return true;
 }
 
 static void wuy_heap_delete_index(wuy_heap_t *heap, size_t index)
 {
 	heap->count--;
-	if (heap->count > 0) {
+	if (index < heap->count) {
+		/* the last one moved here may be less than the parent */
 		wuy_heap_swap(heap, index, heap->count);
-		wuy_heapify_down(heap, index);
+		wuy_heap_fix_node(heap, heap->array[index]);
 	}
 }
 
@@ -268,6 +468,40 @@ void *wuy_heap_pop(wuy_heap_t *heap)
 	return item;
 }
 
+void *wuy_heap_push_bounded(wuy_heap_t *heap, void *item, size_t capacity)
+{
+	wuy_heap_node_t *node = _item_to_node(heap, item);
+	assert(!wuy_heap_is_linked(heap, node));
+	assert(capacity > 0);
+
+	if (heap->count < capacity) {
+		return wuy_heap_push_node(heap, node) ? NULL : item;
+	}
+
+	/* the heap is full, replace the min item if the new one is greater */
+	void *min = _index_to_item(heap, 0);
+	if (!wuy_heap_less_items(heap, min, item)) {
+		return item;
+	}
+
+	heap->array[0] = node;
+	node->index = 0;
+	if (heap->key_cache) {
+		wuy_heap_load_key(heap, 0);
+	}
+	wuy_heapify_down(heap, 0);
+	return min;
+}
+
+size_t wuy_heap_drain_sorted(wuy_heap_t *heap, void *out[])
+{
+	size_t n = heap->count;
+	for (size_t i = n; i > 0; i--) {
+		out[i - 1] = wuy_heap_pop(heap);
+	}
+	return n;
+}
+
 void *wuy_heap_min(wuy_heap_t *heap)
 {
 	if (heap->count == 0) {
@@ -9,6 +9,13 @@
  * @section DESCRIPTION
  *
  * A binary heap, which is a part of libwuya.
+ *
+ * It can be a d-ary heap by wuy_heap_set_arity(). Besides, for numeric
+ * key types, wuy_heap_enable_key_cache() keeps a copy of each item's
+ * key in an array parallel to the item array, so the sifting compares
+ * keys in contiguous memory without dereferencing the items. The
+ * 4-ary heap with key cache has much less cache misses than the
+ * default one for big heaps.
  */
 
 #ifndef WUY_HEAP_H
@@ -87,6 +94,34 @@ wuy_heap_t *wuy_heap_new_func(wuy_heap_less_f *key_less, size_t node_offset);
 wuy_heap_t *wuy_heap_new_type(wuy_heap_key_type_e key_type, size_t key_offset,
 		bool key_reverse, size_t node_offset);
 
+/**
+ * @brief Destroy the heap. The items are not released.
+ */
+void wuy_heap_destroy(wuy_heap_t *heap);
+
+/**
+ * @brief Set the number of children of each node, 2 by default.
+ *
+ * 4 is a good choice for big heaps. The heap gets shallower, and the
+ * children of one node are adjacent in memory.
+ *
+ * @note You MUST NOT call this after pushing any item to the heap.
+ */
+void wuy_heap_set_arity(wuy_heap_t *heap, size_t arity);
+
+/**
+ * @brief Cache the items' keys inside the heap.
+ *
+ * This works for the heap created by wuy_heap_new_type() with numeric
+ * key type only, i.e. not WUY_HEAP_KEY_STRING.
+ *
+ * The key is copied at wuy_heap_push(), so you MUST call wuy_heap_fix()
+ * after changing the key of an item in heap, which is necessary anyway.
+ *
+ * @note You MUST NOT call this after pushing any item to the heap.
+ */
+void wuy_heap_enable_key_cache(wuy_heap_t *heap);
+
 /**
  * @brief Add an item into the heap.
  *
@@ -96,11 +131,51 @@ wuy_heap_t *wuy_heap_new_type(wuy_heap_key_type_e key_type, size_t key_offset,
  */
 bool wuy_heap_push(wuy_heap_t *heap, void *item);
 
+/**
+ * @brief Add a batch of items into the heap.
+ *
+ * If the batch is big relative to the heap, the items are appended
+ * and the whole heap is heapified once, which is O(n) in total.
+ * Otherwise they are pushed one by one.
+ *
+ * @note: It aborts if any item is in the heap already.
+ *
+ * @return true if success, or false if memory allocation fails, and
+ * no item is added in this case.
+ */
+bool wuy_heap_push_many(wuy_heap_t *heap, void *const items[], size_t n);
+
 /**
  * @brief Pop and return the min item.
  */
 void *wuy_heap_pop(wuy_heap_t *heap);
 
+/**
+ * @brief Add an item into the heap which keeps at most capacity items.
+ *
+ * If the heap is full, the item replaces the min one only if it is
+ * greater, in one sift-down. So the heap keeps the top-K greatest
+ * items of a stream in O(n*log(K)) time and K-sized memory.
+ * Create the heap with key_reverse for the top-K least items.
+ *
+ * @note: It aborts if item is in the heap already.
+ *
+ * @return the item dropped: the replaced min item, or the item itself
+ * if it is not greater than the min item or memory allocation fails.
+ * NULL if no item is dropped.
+ */
+void *wuy_heap_push_bounded(wuy_heap_t *heap, void *item, size_t capacity);
+
+/**
+ * @brief Pop all items into out[], which must be big enough.
+ *
+ * The items are stored from the last of out[], so out[0] is the max
+ * item, i.e. the top-1 for wuy_heap_push_bounded().
+ *
+ * @return the number of items.
+ */
+size_t wuy_heap_drain_sorted(wuy_heap_t *heap, void *out[]);
+
 /**
  * @brief Fix an item in the heap.
  *
@@ -116,7 +191,10 @@ void wuy_heap_fix(wuy_heap_t *heap, void *item);
 bool wuy_heap_push_or_fix(wuy_heap_t *heap, void *item);
 
 /**
- * @brief Re-build the heap.
+ * @brief Re-build the heap, in O(n).
+ *
+ * Call this after changing the keys of many items, instead of
+ * calling wuy_heap_fix() for each of them.
  */
 void wuy_heap_rebuild(wuy_heap_t *heap);
 
@@ -137,6 +215,11 @@ void *wuy_heap_min(wuy_heap_t *heap);
  */
 bool wuy_heap_delete(wuy_heap_t *heap, void *item);
 
+/**
+ * @brief Return if item a is less than item b, by the heap's comparison.
+ */
+bool wuy_heap_less_item(wuy_heap_t *heap, const void *a, const void *b);
+
 /**
  * @brief Return the count of items in heap.
  */
@@ -81,6 +81,19 @@ static inline void wuy_hlist_insert(wuy_hlist_t *list, wuy_hlist_node_t *node)
 	node->pprev = &list->first;
 }
 
+/**
+ * @brief Add node after the dest node.
+ */
+static inline void wuy_hlist_add_after(wuy_hlist_node_t *dest, wuy_hlist_node_t *node)
+{
+	wuy_hlist_node_t *next = dest->next;
+	node->next = next;
+	if (next)
+		next->pprev = &node->next;
+	dest->next = node;
+	node->pprev = &dest->next;
+}
+
 /**
  * @brief Delete node from its list.
  */
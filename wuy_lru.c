@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "wuy_lru.h"
+
+/*
+ * The list is ordered from the most recently used at head, to the
+ * least at tail. In CLOCK mode, the hits do not move items, so the
+ * tail is the oldest added or the oldest passed by the clock hand.
+ */
+struct wuy_lru_s {
+	wuy_dict_t		*dict;
+	wuy_list_t		list;
+	size_t			node_offset;
+
+	size_t			bytes;
+	size_t			max_count;
+	size_t			max_bytes;
+
+	bool			clock;
+
+	wuy_lru_evict_f		*evict_handler;
+};
+
+static wuy_lru_t *wuy_lru_new(wuy_dict_t *dict, size_t node_offset)
+{
+	wuy_lru_t *lru = malloc(sizeof(wuy_lru_t));
+	assert(lru != NULL);
+
+	lru->dict = dict;
+	wuy_list_init(&lru->list);
+	lru->node_offset = node_offset;
+	lru->bytes = 0;
+	lru->max_count = 0;
+	lru->max_bytes = 0;
+	lru->clock = false;
+	lru->evict_handler = NULL;
+	return lru;
+}
+
+/* dict_node is the first member of wuy_lru_node_t, so node_offset
+ * is also the offset of the dict node. */
+wuy_lru_t *wuy_lru_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset)
+{
+	return wuy_lru_new(wuy_dict_new_func(key_hash, key_equal, node_offset),
+			node_offset);
+}
+
+wuy_lru_t *wuy_lru_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset)
+{
+	return wuy_lru_new(wuy_dict_new_type(key_type, key_offset, node_offset),
+			node_offset);
+}
+
+static wuy_lru_node_t *_item_to_node(wuy_lru_t *lru, const void *item)
+{
+	return (wuy_lru_node_t *)((char *)item + lru->node_offset);
+}
+static void *_node_to_item(wuy_lru_t *lru, wuy_lru_node_t *node)
+{
+	return (char *)node - lru->node_offset;
+}
+
+void wuy_lru_destroy(wuy_lru_t *lru)
+{
+	wuy_list_node_t *lnode, *safe;
+	wuy_list_iter_safe(&lru->list, lnode, safe) {
+		wuy_lru_node_t *node = wuy_containerof(lnode, wuy_lru_node_t, list_node);
+		if (lru->evict_handler != NULL) {
+			lru->evict_handler(_node_to_item(lru, node));
+		}
+	}
+	wuy_dict_destroy(lru->dict);
+	free(lru);
+}
+
+void wuy_lru_set_max_count(wuy_lru_t *lru, size_t max_count)
+{
+	lru->max_count = max_count;
+}
+
+void wuy_lru_set_max_bytes(wuy_lru_t *lru, size_t max_bytes)
+{
+	lru->max_bytes = max_bytes;
+}
+
+void wuy_lru_set_evict(wuy_lru_t *lru, wuy_lru_evict_f *handler)
+{
+	lru->evict_handler = handler;
+}
+
+void wuy_lru_enable_clock(wuy_lru_t *lru)
+{
+	assert(wuy_dict_count(lru->dict) == 0);
+	lru->clock = true;
+}
+
+static bool wuy_lru_exceed(wuy_lru_t *lru)
+{
+	return (lru->max_count != 0 && wuy_dict_count(lru->dict) > lru->max_count)
+		|| (lru->max_bytes != 0 && lru->bytes > lru->max_bytes);
+}
+
+static void wuy_lru_unlink(wuy_lru_t *lru, wuy_lru_node_t *node)
+{
+	wuy_dict_delete(lru->dict, _node_to_item(lru, node));
+	wuy_list_delete(&node->list_node);
+	lru->bytes -= node->bytes;
+}
+
+static void wuy_lru_evict(wuy_lru_t *lru)
+{
+	while (wuy_lru_exceed(lru)) {
+		wuy_list_node_t *lnode = wuy_list_last(&lru->list);
+		wuy_lru_node_t *node = wuy_containerof(lnode, wuy_lru_node_t, list_node);
+
+		/* second chance for CLOCK */
+		if (node->referenced) {
+			node->referenced = false;
+			wuy_list_delete(lnode);
+			wuy_list_insert(&lru->list, lnode);
+			continue;
+		}
+
+		wuy_lru_unlink(lru, node);
+		if (lru->evict_handler != NULL) {
+			lru->evict_handler(_node_to_item(lru, node));
+		}
+	}
+}
+
+void wuy_lru_add(wuy_lru_t *lru, void *item, size_t bytes)
+{
+	wuy_lru_node_t *node = _item_to_node(lru, item);
+	node->bytes = bytes;
+	node->referenced = false;
+
+	wuy_dict_add(lru->dict, item);
+	wuy_list_insert(&lru->list, &node->list_node);
+	lru->bytes += bytes;
+
+	wuy_lru_evict(lru);
+}
+
+void *_wuy_lru_get(wuy_lru_t *lru, const void *key)
+{
+	void *item = _wuy_dict_get(lru->dict, key);
+	if (item == NULL) {
+		return NULL;
+	}
+
+	wuy_lru_node_t *node = _item_to_node(lru, item);
+	if (lru->clock) {
+		node->referenced = true;
+	} else {
+		wuy_list_delete(&node->list_node);
+		wuy_list_insert(&lru->list, &node->list_node);
+	}
+	return item;
+}
+
+void wuy_lru_delete(wuy_lru_t *lru, void *item)
+{
+	wuy_lru_unlink(lru, _item_to_node(lru, item));
+}
+
+void *_wuy_lru_del_key(wuy_lru_t *lru, const void *key)
+{
+	void *item = _wuy_dict_get(lru->dict, key);
+	if (item == NULL) {
+		return NULL;
+	}
+	wuy_lru_delete(lru, item);
+	return item;
+}
+
+size_t wuy_lru_count(wuy_lru_t *lru)
+{
+	return wuy_dict_count(lru->dict);
+}
+
+size_t wuy_lru_bytes(wuy_lru_t *lru)
+{
+	return lru->bytes;
+}
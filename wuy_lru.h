@@ -0,0 +1,155 @@
+/**
+ * @file     wuy_lru.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-26
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * A LRU cache, based on wuy_dict and wuy_list.
+ *
+ * The cache is limited by the count of items, or the total bytes, or
+ * both. When the limit is exceeded after adding, the least recently
+ * used items are evicted, and passed to the evict handler.
+ *
+ * By default, each hit moves the item to the head of list. If
+ * wuy_lru_enable_clock() is called, each hit just marks the item
+ * referenced, and the referenced items get a second chance at
+ * eviction, which is the CLOCK approximation. This avoids the list
+ * mutation on hits for read-heavy workloads.
+ */
+
+#ifndef WUY_LRU_H
+#define WUY_LRU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+#include "wuy_list.h"
+
+/**
+ * @brief The LRU cache.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_lru_s wuy_lru_t;
+
+/**
+ * @brief Embed this node into your data struct in order to use this lib.
+ *
+ * You need not initialize or touch it.
+ */
+typedef struct {
+	wuy_dict_node_t		dict_node;
+	wuy_list_node_t		list_node;
+	size_t			bytes;
+	bool			referenced;
+} wuy_lru_node_t;
+
+/**
+ * @brief Called when an item is evicted.
+ */
+typedef void wuy_lru_evict_f(void *item);
+
+/**
+ * @brief Create a LRU cache, with the user-defined key hash/equal function.
+ *
+ * @param node_offset the offset of wuy_lru_node_t in your data struct.
+ *
+ * Other parameters are same with wuy_dict_new_func().
+ *
+ * @return the new cache. It aborts the program if memory allocation fails.
+ */
+wuy_lru_t *wuy_lru_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset);
+
+/**
+ * @brief Create a LRU cache, with general key type.
+ *
+ * @param node_offset the offset of wuy_lru_node_t in your data struct.
+ *
+ * Other parameters are same with wuy_dict_new_type().
+ *
+ * @return the new cache. It aborts the program if memory allocation fails.
+ */
+wuy_lru_t *wuy_lru_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset);
+
+/**
+ * @brief Destroy the cache. The evict handler is called for all items if set.
+ */
+void wuy_lru_destroy(wuy_lru_t *lru);
+
+/**
+ * @brief Set the max count of items. 0 means no limit, which is the default.
+ */
+void wuy_lru_set_max_count(wuy_lru_t *lru, size_t max_count);
+
+/**
+ * @brief Set the max total bytes of items. 0 means no limit, which is the default.
+ */
+void wuy_lru_set_max_bytes(wuy_lru_t *lru, size_t max_bytes);
+
+/**
+ * @brief Set the handler called when an item is evicted.
+ */
+void wuy_lru_set_evict(wuy_lru_t *lru, wuy_lru_evict_f *handler);
+
+/**
+ * @brief Use CLOCK approximation instead of strict LRU.
+ *
+ * @note You MUST NOT call this after adding any item.
+ */
+void wuy_lru_enable_clock(wuy_lru_t *lru);
+
+/**
+ * @brief Add the item into cache, and evict items if exceeds the limits.
+ *
+ * @param bytes the size of the item, counted for max_bytes.
+ *
+ * @note The item itself may be evicted too, if its bytes is bigger
+ * than max_bytes.
+ */
+void wuy_lru_add(wuy_lru_t *lru, void *item, size_t bytes);
+
+/**
+ * @brief Search item from cache by the key, and mark it used.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_lru_get(lru, key) _wuy_lru_get(lru, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_lru_get. You should not use this directly. */
+void *_wuy_lru_get(wuy_lru_t *lru, const void *key);
+
+/**
+ * @brief Delete the item from cache. The evict handler is not called.
+ */
+void wuy_lru_delete(wuy_lru_t *lru, void *item);
+
+/**
+ * @brief Delete a key from cache. The evict handler is not called.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_lru_del_key(lru, key) _wuy_lru_del_key(lru, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_lru_del_key. You should not use this directly. */
+void *_wuy_lru_del_key(wuy_lru_t *lru, const void *key);
+
+/**
+ * @brief Return the count of items in cache.
+ */
+size_t wuy_lru_count(wuy_lru_t *lru);
+
+/**
+ * @brief Return the total bytes of items in cache.
+ */
+size_t wuy_lru_bytes(wuy_lru_t *lru);
+
+#endif
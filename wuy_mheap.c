@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "wuy_time.h"
+#include "wuy_mheap.h"
+
+/* aligned to cache line to avoid false sharing between queues */
+struct wuy_mheap_queue {
+	pthread_mutex_t		lock;
+	wuy_heap_t		*heap;
+	size_t			count; /* read without lock, for skipping empty queues */
+} __attribute__((aligned(64)));
+
+struct wuy_mheap_s {
+	int			queue_num;
+	size_t			node_offset;
+	struct wuy_mheap_queue	*queues;
+};
+
+static wuy_mheap_t *wuy_mheap_new(size_t node_offset, int queues)
+{
+	assert(queues > 0);
+
+	wuy_mheap_t *mheap = malloc(sizeof(wuy_mheap_t));
+	assert(mheap != NULL);
+
+	mheap->queue_num = queues;
+	mheap->node_offset = node_offset;
+	mheap->queues = aligned_alloc(64, sizeof(struct wuy_mheap_queue) * queues);
+	assert(mheap->queues != NULL);
+
+	for (int i = 0; i < queues; i++) {
+		pthread_mutex_init(&mheap->queues[i].lock, NULL);
+		mheap->queues[i].count = 0;
+	}
+	return mheap;
+}
+
+/* heap_node is the first member of wuy_mheap_node_t, so node_offset
+ * is also the offset of the heap node. */
+wuy_mheap_t *wuy_mheap_new_func(wuy_heap_less_f *key_less, size_t node_offset,
+		int queues)
+{
+	wuy_mheap_t *mheap = wuy_mheap_new(node_offset, queues);
+	for (int i = 0; i < queues; i++) {
+		mheap->queues[i].heap = wuy_heap_new_func(key_less, node_offset);
+	}
+	return mheap;
+}
+
+wuy_mheap_t *wuy_mheap_new_type(wuy_heap_key_type_e key_type, size_t key_offset,
+		bool key_reverse, size_t node_offset, int queues)
+{
+	wuy_mheap_t *mheap = wuy_mheap_new(node_offset, queues);
+	for (int i = 0; i < queues; i++) {
+		mheap->queues[i].heap = wuy_heap_new_type(key_type, key_offset,
+				key_reverse, node_offset);
+	}
+	return mheap;
+}
+
+void wuy_mheap_destroy(wuy_mheap_t *mheap)
+{
+	for (int i = 0; i < mheap->queue_num; i++) {
+		pthread_mutex_destroy(&mheap->queues[i].lock);
+		wuy_heap_destroy(mheap->queues[i].heap);
+	}
+	free(mheap->queues);
+	free(mheap);
+}
+
+static wuy_mheap_node_t *_item_to_node(wuy_mheap_t *mheap, const void *item)
+{
+	return (wuy_mheap_node_t *)((char *)item + mheap->node_offset);
+}
+
+/* xorshift per thread, to avoid the lock inside random() */
+static int wuy_mheap_rand(int range)
+{
+	static __thread uint64_t state = 0;
+	if (state == 0) {
+		state = ((uintptr_t)&state ^ wuy_time_us()) | 1;
+	}
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state % range;
+}
+
+static void wuy_mheap_update_count(struct wuy_mheap_queue *queue)
+{
+	__atomic_store_n(&queue->count, wuy_heap_count(queue->heap), __ATOMIC_RELAXED);
+}
+static bool wuy_mheap_queue_empty(struct wuy_mheap_queue *queue)
+{
+	return __atomic_load_n(&queue->count, __ATOMIC_RELAXED) == 0;
+}
+
+bool wuy_mheap_push(wuy_mheap_t *mheap, void *item)
+{
+	wuy_mheap_node_t *node = _item_to_node(mheap, item);
+
+	int q = wuy_mheap_rand(mheap->queue_num);
+	struct wuy_mheap_queue *queue = &mheap->queues[q];
+
+	pthread_mutex_lock(&queue->lock);
+	__atomic_store_n(&node->queue, q, __ATOMIC_RELAXED);
+	bool ret = wuy_heap_push(queue->heap, item);
+	wuy_mheap_update_count(queue);
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+static void *wuy_mheap_pop_queue(struct wuy_mheap_queue *queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	void *item = wuy_heap_pop(queue->heap);
+	wuy_mheap_update_count(queue);
+	pthread_mutex_unlock(&queue->lock);
+	return item;
+}
+
+/* pop the less one from 2 queues */
+static void *wuy_mheap_pop_two(wuy_mheap_t *mheap, int i, int j)
+{
+	/* lock in order to avoid deadlock */
+	if (i > j) {
+		int tmp = i;
+		i = j;
+		j = tmp;
+	}
+	struct wuy_mheap_queue *qi = &mheap->queues[i];
+	struct wuy_mheap_queue *qj = &mheap->queues[j];
+
+	pthread_mutex_lock(&qi->lock);
+	pthread_mutex_lock(&qj->lock);
+
+	void *mi = wuy_heap_min(qi->heap);
+	void *mj = wuy_heap_min(qj->heap);
+
+	void *item = NULL;
+	if (mi != NULL && (mj == NULL || !wuy_heap_less_item(qj->heap, mj, mi))) {
+		item = wuy_heap_pop(qi->heap);
+		wuy_mheap_update_count(qi);
+	} else if (mj != NULL) {
+		item = wuy_heap_pop(qj->heap);
+		wuy_mheap_update_count(qj);
+	}
+
+	pthread_mutex_unlock(&qj->lock);
+	pthread_mutex_unlock(&qi->lock);
+	return item;
+}
+
+void *wuy_mheap_pop(wuy_mheap_t *mheap)
+{
+	int n = mheap->queue_num;
+	if (n == 1) {
+		return wuy_mheap_pop_queue(&mheap->queues[0]);
+	}
+
+	int i = wuy_mheap_rand(n);
+	int j = (i + 1 + wuy_mheap_rand(n - 1)) % n;
+	bool ei = wuy_mheap_queue_empty(&mheap->queues[i]);
+	bool ej = wuy_mheap_queue_empty(&mheap->queues[j]);
+
+	void *item = NULL;
+	if (!ei && !ej) {
+		item = wuy_mheap_pop_two(mheap, i, j);
+	} else if (!ei) {
+		item = wuy_mheap_pop_queue(&mheap->queues[i]);
+	} else if (!ej) {
+		item = wuy_mheap_pop_queue(&mheap->queues[j]);
+	}
+	if (item != NULL) {
+		return item;
+	}
+
+	/* both are empty, so scan all queues before returning NULL */
+	for (int k = 0; k < n; k++) {
+		struct wuy_mheap_queue *queue = &mheap->queues[(i + k) % n];
+		if (wuy_mheap_queue_empty(queue)) {
+			continue;
+		}
+		item = wuy_mheap_pop_queue(queue);
+		if (item != NULL) {
+			return item;
+		}
+	}
+	return NULL;
+}
+
+bool wuy_mheap_delete(wuy_mheap_t *mheap, void *item)
+{
+	wuy_mheap_node_t *node = _item_to_node(mheap, item);
+	struct wuy_mheap_queue *queue = &mheap->queues[
+			__atomic_load_n(&node->queue, __ATOMIC_RELAXED)];
+
+	pthread_mutex_lock(&queue->lock);
+	bool ret = wuy_heap_delete(queue->heap, item);
+	wuy_mheap_update_count(queue);
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+size_t wuy_mheap_count(wuy_mheap_t *mheap)
+{
+	size_t count = 0;
+	for (int i = 0; i < mheap->queue_num; i++) {
+		count += __atomic_load_n(&mheap->queues[i].count, __ATOMIC_RELAXED);
+	}
+	return count;
+}
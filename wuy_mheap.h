@@ -0,0 +1,114 @@
+/**
+ * @file     wuy_mheap.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-8-4
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * A thread-safe relaxed priority queue, based on wuy_heap, which is
+ * known as MultiQueue.
+ *
+ * It consists of several wuy_heap, each of which is protected by its
+ * own lock. Pushing puts the item into a random heap. Popping picks
+ * two random heaps, and pops the less min item of them. So threads
+ * rarely contend with each other.
+ *
+ * The cost is that popping is relaxed: it does not always return the
+ * global min item, but one of the several smallest ones. This is fine
+ * for schedulers, e.g. deferred jobs of a worker pool.
+ *
+ * The usage is similar with wuy_heap.
+ */
+
+#ifndef WUY_MHEAP_H
+#define WUY_MHEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wuy_heap.h"
+
+/**
+ * @brief The heap.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_mheap_s wuy_mheap_t;
+
+/**
+ * @brief Embed this node into your data struct in order to use this lib.
+ */
+typedef struct {
+	wuy_heap_node_t	heap_node;
+	int		queue;
+} wuy_mheap_node_t;
+
+/**
+ * @brief Create a heap, with the user-defined comparison function.
+ *
+ * @param queues number of internal heaps, 2 or 4 times of the number
+ *        of threads is suggested.
+ * @param node_offset the offset of wuy_mheap_node_t in your data struct.
+ *
+ * Other parameters are same with wuy_heap_new_func().
+ *
+ * @return the new heap. It aborts the program if memory allocation fails.
+ */
+wuy_mheap_t *wuy_mheap_new_func(wuy_heap_less_f *key_less, size_t node_offset,
+		int queues);
+
+/**
+ * @brief Create a heap, with general comparison key type.
+ *
+ * @param queues number of internal heaps, 2 or 4 times of the number
+ *        of threads is suggested.
+ * @param node_offset the offset of wuy_mheap_node_t in your data struct.
+ *
+ * Other parameters are same with wuy_heap_new_type().
+ *
+ * @return the new heap. It aborts the program if memory allocation fails.
+ */
+wuy_mheap_t *wuy_mheap_new_type(wuy_heap_key_type_e key_type, size_t key_offset,
+		bool key_reverse, size_t node_offset, int queues);
+
+/**
+ * @brief Destroy the heap. The items are not released.
+ */
+void wuy_mheap_destroy(wuy_mheap_t *mheap);
+
+/**
+ * @brief Add an item into the heap.
+ *
+ * @return true if success, or false if memory allocation fails.
+ */
+bool wuy_mheap_push(wuy_mheap_t *mheap, void *item);
+
+/**
+ * @brief Pop and return one of the smallest items.
+ *
+ * @return the item, or NULL if the heap is empty.
+ */
+void *wuy_mheap_pop(wuy_mheap_t *mheap);
+
+/**
+ * @brief Delete the item from heap.
+ *
+ * The item MUST have been pushed into this heap before. You MUST make
+ * sure that it is not being pushed by other threads at the same time,
+ * while it's OK to be popped.
+ *
+ * @return true if success, or false if the item is not in the heap.
+ */
+bool wuy_mheap_delete(wuy_mheap_t *mheap, void *item);
+
+/**
+ * @brief Return the count of items in heap.
+ *
+ * It's not accurate if other threads are pushing or popping.
+ */
+size_t wuy_mheap_count(wuy_mheap_t *mheap);
+
+#endif
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wuy_shmpool.h"
+#include "wuy_nop_dict.h"
+
+/*
+ * The memory layout, all in one shared-memory region:
+ *
+ *   struct wuy_nop_dict_s | buckets | items
+ *
+ * The dict is the base of wuy_nop_hlist, so all addresses are
+ * offsets from the dict. Since the dict is at offset 0, the 0
+ * offset means NULL.
+ *
+ * Free items are linked by the next field of their nodes.
+ *
+ * The region from a named wuy_shmpool may be kept from the previous
+ * run. If it holds a dict of general key type with the same settings
+ * already, which is checked by the magic and the layout fields, it's
+ * attached with all items kept. The dict with user-defined functions
+ * is never attached, because the function addresses are meaningless
+ * out of the creator's image.
+ */
+#define WUY_NOP_DICT_MAGIC	0x4e4f5044 /* "NOPD" */
+
+struct wuy_nop_dict_bucket {
+	uint32_t		lock;
+	wuy_nop_hlist_t		list;
+};
+
+struct wuy_nop_dict_s {
+	uint32_t		magic;
+
+	wuy_dict_hash_f		*key_hash;
+	wuy_dict_equal_f	*key_equal;
+	wuy_dict_key_type_e	key_type;
+	size_t			key_offset;
+	size_t			node_offset;
+
+	size_t			item_size;
+	uint32_t		capacity;
+	uint32_t		bucket_size;
+	uint32_t		items_offset;
+
+	uint32_t		count;
+
+	uint32_t		free_lock;
+	uint32_t		free_first;
+
+	struct wuy_nop_dict_bucket	buckets[0];
+};
+
+static void wuy_nop_dict_lock(uint32_t *lock)
+{
+	while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+		while (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0) {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+		}
+	}
+}
+static void wuy_nop_dict_unlock(uint32_t *lock)
+{
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+static void *_offset_to_ptr(wuy_nop_dict_t *dict, uint32_t offset)
+{
+	return (char *)dict + offset;
+}
+static uint32_t _ptr_to_offset(wuy_nop_dict_t *dict, const void *p)
+{
+	return (const char *)p - (const char *)dict;
+}
+static const void *_item_to_key(wuy_nop_dict_t *dict, const void *item)
+{
+	return (const char *)item + dict->key_offset;
+}
+static wuy_nop_hlist_node_t *_item_to_node(wuy_nop_dict_t *dict, const void *item)
+{
+	return (wuy_nop_hlist_node_t *)((char *)item + dict->node_offset);
+}
+static void *_node_to_item(wuy_nop_dict_t *dict, wuy_nop_hlist_node_t *node)
+{
+	return (char *)node - dict->node_offset;
+}
+
+static wuy_nop_dict_t *wuy_nop_dict_new(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset,
+		size_t item_size, uint32_t capacity)
+{
+	uint32_t bucket_size = 1;
+	while (bucket_size < capacity) {
+		bucket_size <<= 1;
+	}
+
+	item_size = (item_size + 7) / 8 * 8;
+
+	size_t items_offset = sizeof(wuy_nop_dict_t)
+			+ sizeof(struct wuy_nop_dict_bucket) * bucket_size;
+	items_offset = (items_offset + 7) / 8 * 8;
+
+	size_t total = items_offset + item_size * capacity;
+	if (total > UINT32_MAX) {
+		return NULL;
+	}
+
+	wuy_nop_dict_t *dict = wuy_shmpool_alloc(total);
+	if (dict == NULL) {
+		return NULL;
+	}
+
+	if (key_hash == NULL && dict->magic == WUY_NOP_DICT_MAGIC
+			&& dict->key_hash == NULL
+			&& dict->key_type == key_type
+			&& dict->key_offset == key_offset
+			&& dict->node_offset == node_offset
+			&& dict->item_size == item_size
+			&& dict->capacity == capacity) {
+		/* The locks may be left held by the killed processes
+		 * of the previous run, so release them all. */
+		for (uint32_t i = 0; i < bucket_size; i++) {
+			__atomic_store_n(&dict->buckets[i].lock, 0, __ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&dict->free_lock, 0, __ATOMIC_RELEASE);
+		return dict;
+	}
+
+	memset(dict, 0, items_offset);
+	dict->key_hash = key_hash;
+	dict->key_equal = key_equal;
+	dict->key_type = key_type;
+	dict->key_offset = key_offset;
+	dict->node_offset = node_offset;
+	dict->item_size = item_size;
+	dict->capacity = capacity;
+	dict->bucket_size = bucket_size;
+	dict->items_offset = items_offset;
+
+	/* link all items into free list */
+	uint32_t offset = items_offset + item_size * capacity;
+	for (uint32_t i = 0; i < capacity; i++) {
+		offset -= item_size;
+		_item_to_node(dict, _offset_to_ptr(dict, offset))->next = dict->free_first;
+		dict->free_first = offset;
+	}
+
+	dict->magic = WUY_NOP_DICT_MAGIC;
+	return dict;
+}
+
+wuy_nop_dict_t *wuy_nop_dict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset,
+		size_t item_size, uint32_t capacity)
+{
+	return wuy_nop_dict_new(key_hash, key_equal, 100, 0,
+			node_offset, item_size, capacity);
+}
+
+wuy_nop_dict_t *wuy_nop_dict_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset,
+		size_t item_size, uint32_t capacity)
+{
+	assert(key_type == WUY_DICT_KEY_UINT32 || key_type == WUY_DICT_KEY_UINT64);
+
+	return wuy_nop_dict_new(NULL, NULL, key_type, key_offset,
+			node_offset, item_size, capacity);
+}
+
+void *wuy_nop_dict_alloc(wuy_nop_dict_t *dict)
+{
+	wuy_nop_dict_lock(&dict->free_lock);
+
+	uint32_t offset = dict->free_first;
+	if (offset == 0) {
+		wuy_nop_dict_unlock(&dict->free_lock);
+		return NULL;
+	}
+
+	void *item = _offset_to_ptr(dict, offset);
+	dict->free_first = _item_to_node(dict, item)->next;
+
+	wuy_nop_dict_unlock(&dict->free_lock);
+
+	memset(item, 0, dict->item_size);
+	return item;
+}
+
+void wuy_nop_dict_free(wuy_nop_dict_t *dict, void *item)
+{
+	wuy_nop_dict_lock(&dict->free_lock);
+
+	_item_to_node(dict, item)->next = dict->free_first;
+	dict->free_first = _ptr_to_offset(dict, item);
+
+	wuy_nop_dict_unlock(&dict->free_lock);
+}
+
+static uint32_t wuy_nop_dict_hash_key(wuy_nop_dict_t *dict, const void *key)
+{
+	if (dict->key_hash != NULL) {
+		return dict->key_hash(key);
+	}
+	return _wuy_dict_type_hash_key(dict->key_type, 0, key);
+}
+static uint32_t wuy_nop_dict_hash_item(wuy_nop_dict_t *dict, const void *item)
+{
+	if (dict->key_hash != NULL) {
+		return dict->key_hash(item);
+	}
+	return _wuy_dict_type_hash_item_key(dict->key_type, 0, _item_to_key(dict, item));
+}
+
+static bool wuy_nop_dict_equal_key(wuy_nop_dict_t *dict, const void *item, const void *key)
+{
+	if (dict->key_equal != NULL) {
+		return dict->key_equal(item, key);
+	}
+	return _wuy_dict_type_equal_key(dict->key_type, 0, _item_to_key(dict, item), key);
+}
+
+static struct wuy_nop_dict_bucket *wuy_nop_dict_bucket(wuy_nop_dict_t *dict, uint32_t hash)
+{
+	return &dict->buckets[hash & (dict->bucket_size - 1)];
+}
+
+/* search in bucket, which MUST be locked */
+static void *wuy_nop_dict_search(wuy_nop_dict_t *dict,
+		struct wuy_nop_dict_bucket *bucket, const void *key)
+{
+	wuy_nop_hlist_node_t *node;
+	wuy_nop_hlist_iter(&bucket->list, node, (void *)dict) {
+		void *item = _node_to_item(dict, node);
+		if (wuy_nop_dict_equal_key(dict, item, key)) {
+			return item;
+		}
+	}
+	return NULL;
+}
+
+void wuy_nop_dict_add(wuy_nop_dict_t *dict, void *item)
+{
+	struct wuy_nop_dict_bucket *bucket = wuy_nop_dict_bucket(dict,
+			wuy_nop_dict_hash_item(dict, item));
+
+	wuy_nop_dict_lock(&bucket->lock);
+	wuy_nop_hlist_insert(&bucket->list, _item_to_node(dict, item), dict);
+	wuy_nop_dict_unlock(&bucket->lock);
+
+	__atomic_add_fetch(&dict->count, 1, __ATOMIC_RELAXED);
+}
+
+void *wuy_nop_dict_add_unique(wuy_nop_dict_t *dict, void *item)
+{
+	struct wuy_nop_dict_bucket *bucket = wuy_nop_dict_bucket(dict,
+			wuy_nop_dict_hash_item(dict, item));
+
+	/* the search key is the item itself for function-defined dict,
+	 * or the key value for general key type */
+	const void *key = item;
+	if (dict->key_hash == NULL) {
+		const void *item_key = _item_to_key(dict, item);
+		key = dict->key_type == WUY_DICT_KEY_UINT32
+				? (const void *)(uintptr_t)*(uint32_t *)item_key
+				: (const void *)(uintptr_t)*(uint64_t *)item_key;
+	}
+
+	wuy_nop_dict_lock(&bucket->lock);
+
+	void *exist = wuy_nop_dict_search(dict, bucket, key);
+	if (exist == NULL) {
+		wuy_nop_hlist_insert(&bucket->list, _item_to_node(dict, item), dict);
+		__atomic_add_fetch(&dict->count, 1, __ATOMIC_RELAXED);
+	}
+
+	wuy_nop_dict_unlock(&bucket->lock);
+
+	return exist != NULL ? exist : item;
+}
+
+void *_wuy_nop_dict_get(wuy_nop_dict_t *dict, const void *key)
+{
+	struct wuy_nop_dict_bucket *bucket = wuy_nop_dict_bucket(dict,
+			wuy_nop_dict_hash_key(dict, key));
+
+	wuy_nop_dict_lock(&bucket->lock);
+	void *item = wuy_nop_dict_search(dict, bucket, key);
+	wuy_nop_dict_unlock(&bucket->lock);
+
+	return item;
+}
+
+void wuy_nop_dict_delete(wuy_nop_dict_t *dict, void *item)
+{
+	struct wuy_nop_dict_bucket *bucket = wuy_nop_dict_bucket(dict,
+			wuy_nop_dict_hash_item(dict, item));
+
+	wuy_nop_dict_lock(&bucket->lock);
+	wuy_nop_hlist_delete(_item_to_node(dict, item), dict);
+	wuy_nop_dict_unlock(&bucket->lock);
+
+	__atomic_sub_fetch(&dict->count, 1, __ATOMIC_RELAXED);
+}
+
+void *_wuy_nop_dict_del_key(wuy_nop_dict_t *dict, const void *key)
+{
+	struct wuy_nop_dict_bucket *bucket = wuy_nop_dict_bucket(dict,
+			wuy_nop_dict_hash_key(dict, key));
+
+	wuy_nop_dict_lock(&bucket->lock);
+	void *item = wuy_nop_dict_search(dict, bucket, key);
+	if (item != NULL) {
+		wuy_nop_hlist_delete(_item_to_node(dict, item), dict);
+	}
+	wuy_nop_dict_unlock(&bucket->lock);
+
+	if (item != NULL) {
+		__atomic_sub_fetch(&dict->count, 1, __ATOMIC_RELAXED);
+	}
+	return item;
+}
+
+uint32_t wuy_nop_dict_count(wuy_nop_dict_t *dict)
+{
+	return __atomic_load_n(&dict->count, __ATOMIC_RELAXED);
+}
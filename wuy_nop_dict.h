@@ -0,0 +1,153 @@
+/**
+ * @file     wuy_nop_dict.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-22
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * A dictionary in shared-memory, based on wuy_nop_hlist.h and wuy_shmpool.
+ *
+ * The dict, including buckets and items, lives in one region allocated
+ * by wuy_shmpool_alloc(), and uses relative offset as pointer. So it
+ * can be shared by worker processes.
+ *
+ * The capacity is fixed at creation. Items are allocated from the dict
+ * by wuy_nop_dict_alloc() instead of malloc().
+ *
+ * Each bucket is protected by a spinlock, so the add/get/delete can be
+ * called by multiple processes concurrently.
+ *
+ * If the shared-memory region holds a dict with the same settings
+ * already, e.g. created by the previous run with the same wuy_shmpool
+ * name, wuy_nop_dict_new_type() attaches to it and keeps all items,
+ * instead of clearing it. All locks are released when attaching, so
+ * the processes of the previous run MUST have exited by then.
+ * wuy_nop_dict_new_func() always clears the region.
+ *
+ * Since the key must be same for all processes, only WUY_DICT_KEY_UINT32
+ * and WUY_DICT_KEY_UINT64 are supported for wuy_nop_dict_new_type().
+ * For other keys, use wuy_nop_dict_new_func() and keep the key inside
+ * the item, e.g. a char array.
+ */
+
+#ifndef WUY_NOP_DICT_H
+#define WUY_NOP_DICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+#include "wuy_nop_hlist.h"
+
+/**
+ * @brief The dict.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_nop_dict_s wuy_nop_dict_t;
+
+/**
+ * @brief Embed this node into your data struct in order to use this lib.
+ */
+typedef wuy_nop_hlist_node_t wuy_nop_dict_node_t;
+
+/**
+ * @brief Create a dict in shared-memory, with the user-defined key hash/equal function.
+ *
+ * The function pointers are shared too, so the processes must be
+ * forked from the creator.
+ *
+ * @param item_size the size of your data struct.
+ * @param capacity the max number of items.
+ *
+ * Other parameters are same with wuy_dict_new_func().
+ *
+ * @return the new dict, or NULL if the shared-memory allocation fails.
+ */
+wuy_nop_dict_t *wuy_nop_dict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset,
+		size_t item_size, uint32_t capacity);
+
+/**
+ * @brief Create a dict in shared-memory, with general key type.
+ *
+ * @param item_size the size of your data struct.
+ * @param capacity the max number of items.
+ *
+ * Other parameters are same with wuy_dict_new_type().
+ *
+ * @return the new dict, or NULL if the shared-memory allocation fails.
+ */
+wuy_nop_dict_t *wuy_nop_dict_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset,
+		size_t item_size, uint32_t capacity);
+
+/**
+ * @brief Allocate a zeroed item from the dict.
+ *
+ * @return the item, or NULL if the dict is full.
+ */
+void *wuy_nop_dict_alloc(wuy_nop_dict_t *dict);
+
+/**
+ * @brief Return the item to the dict. It MUST not be in the dict.
+ */
+void wuy_nop_dict_free(wuy_nop_dict_t *dict, void *item);
+
+/**
+ * @brief Add the item into dict.
+ */
+void wuy_nop_dict_add(wuy_nop_dict_t *dict, void *item);
+
+/**
+ * @brief Add the item into dict if its key does not exist.
+ *
+ * This is an atomic combine of wuy_nop_dict_get() and wuy_nop_dict_add().
+ *
+ * @return the item with the same key if exists, or the item itself if
+ * it's added.
+ */
+void *wuy_nop_dict_add_unique(wuy_nop_dict_t *dict, void *item);
+
+/**
+ * @brief Search item from dict by the key.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @note The bucket is unlocked when this returns, so you must make
+ * sure by yourself that the item is not deleted by other processes,
+ * and update the item by atomic operations.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_nop_dict_get(dict, key) _wuy_nop_dict_get(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_nop_dict_get. You should not use this directly. */
+void *_wuy_nop_dict_get(wuy_nop_dict_t *dict, const void *key);
+
+/**
+ * @brief Delete the item from dict.
+ *
+ * You MUST make sure that item is in this dict. The item is not freed.
+ */
+void wuy_nop_dict_delete(wuy_nop_dict_t *dict, void *item);
+
+/**
+ * @brief Delete a key from dict. The item is not freed.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_nop_dict_del_key(dict, key) _wuy_nop_dict_del_key(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_nop_dict_del_key. You should not use this directly. */
+void *_wuy_nop_dict_del_key(wuy_nop_dict_t *dict, const void *key);
+
+/**
+ * @brief Return the count of items in dict.
+ */
+uint32_t wuy_nop_dict_count(wuy_nop_dict_t *dict);
+
+#endif
@@ -81,7 +81,7 @@ static inline void wuy_nop_hlist_insert(wuy_nop_hlist_t *list,
 		first->pprev = node_addr + offsetof(wuy_nop_hlist_node_t, next);
 	}
 	list->first = node_addr;
-	node->pprev = 0;
+	node->pprev = _nop_hlist_2addr((const wuy_nop_hlist_node_t *)&list->first, base);
 }
 
 /**
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "wuy_oadict.h"
+
+/*
+ * Each slot has a control byte:
+ *   - EMPTY, never used;
+ *   - DELETED, used but deleted later (tombstone);
+ *   - 0~0x7F, in use, and it's the 7-bit tag of the item's hash.
+ *
+ * The slots are divided into groups of 16. The probe sequence goes
+ * group by group, so we check the 16 control bytes of a group at once.
+ * A lookup stops at the first group which has an EMPTY slot.
+ */
+#define WUY_OADICT_CTRL_EMPTY		((uint8_t)0x80)
+#define WUY_OADICT_CTRL_DELETED		((uint8_t)0xFE)
+
+#define WUY_OADICT_GROUP		16
+#define WUY_OADICT_SIZE_INIT		64
+
+struct wuy_oadict_s {
+	wuy_dict_hash_f		*key_hash;
+	wuy_dict_equal_f	*key_equal;
+	wuy_dict_key_type_e	key_type;
+	size_t			key_offset;
+
+	uint8_t			*ctrls;
+	void			**items;
+
+	uint32_t		capacity;
+	uint32_t		growth_left;
+
+	size_t			count;
+};
+
+static uint32_t wuy_oadict_max_load(uint32_t capacity)
+{
+	return capacity - capacity / 8;
+}
+
+static void wuy_oadict_alloc(wuy_oadict_t *dict, uint32_t capacity)
+{
+	dict->ctrls = aligned_alloc(WUY_OADICT_GROUP, capacity);
+	assert(dict->ctrls != NULL);
+	memset(dict->ctrls, WUY_OADICT_CTRL_EMPTY, capacity);
+
+	dict->items = malloc(sizeof(void *) * capacity);
+	assert(dict->items != NULL);
+
+	dict->capacity = capacity;
+	dict->growth_left = wuy_oadict_max_load(capacity);
+}
+
+static wuy_oadict_t *wuy_oadict_new(void)
+{
+	wuy_oadict_t *dict = malloc(sizeof(wuy_oadict_t));
+	assert(dict != NULL);
+
+	wuy_oadict_alloc(dict, WUY_OADICT_SIZE_INIT);
+	dict->count = 0;
+	return dict;
+}
+
+wuy_oadict_t *wuy_oadict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal)
+{
+	wuy_oadict_t *dict = wuy_oadict_new();
+	dict->key_hash = key_hash;
+	dict->key_equal = key_equal;
+	dict->key_type = 100;
+	dict->key_offset = 0;
+	return dict;
+}
+
+wuy_oadict_t *wuy_oadict_new_type(wuy_dict_key_type_e key_type, size_t key_offset)
+{
+	/* no key length here */
+	assert(key_type != WUY_DICT_KEY_BINARY);
+
+	wuy_oadict_t *dict = wuy_oadict_new();
+	dict->key_hash = NULL;
+	dict->key_equal = NULL;
+	dict->key_type = key_type;
+	dict->key_offset = key_offset;
+	return dict;
+}
+
+void wuy_oadict_destroy(wuy_oadict_t *dict)
+{
+	free(dict->ctrls);
+	free(dict->items);
+	free(dict);
+}
+
+static const void *_item_to_key(wuy_oadict_t *dict, const void *item)
+{
+	return (const char *)item + dict->key_offset;
+}
+
+/* The tag and the group index are taken from different bits
+ * of the hash value, so mix it for the identity hashes. */
+static uint32_t wuy_oadict_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint32_t wuy_oadict_hash_key(wuy_oadict_t *dict, const void *key)
+{
+	if (dict->key_hash != NULL) {
+		return wuy_oadict_mix(dict->key_hash(key));
+	}
+	return wuy_oadict_mix(_wuy_dict_type_hash_key(dict->key_type, 0, key));
+}
+static uint32_t wuy_oadict_hash_item(wuy_oadict_t *dict, const void *item)
+{
+	if (dict->key_hash != NULL) {
+		return wuy_oadict_mix(dict->key_hash(item));
+	}
+	return wuy_oadict_mix(_wuy_dict_type_hash_item_key(dict->key_type, 0,
+				_item_to_key(dict, item)));
+}
+
+static bool wuy_oadict_equal_key(wuy_oadict_t *dict, const void *item, const void *key)
+{
+	if (dict->key_equal != NULL) {
+		return dict->key_equal(item, key);
+	}
+	return _wuy_dict_type_equal_key(dict->key_type, 0, _item_to_key(dict, item), key);
+}
+
+static uint8_t wuy_oadict_tag(uint32_t hash)
+{
+	return hash >> 25;
+}
+static uint32_t wuy_oadict_group(wuy_oadict_t *dict, uint32_t hash)
+{
+	return hash & (dict->capacity / WUY_OADICT_GROUP - 1);
+}
+/* triangular probing, which visits all groups since the
+ * number of groups is power of 2 */
+static uint32_t wuy_oadict_group_next(wuy_oadict_t *dict, uint32_t group, uint32_t i)
+{
+	return (group + i) & (dict->capacity / WUY_OADICT_GROUP - 1);
+}
+
+/* return the bitmask of slots in the group whose control byte is @c */
+static uint32_t wuy_oadict_match(const uint8_t *ctrls, uint8_t c)
+{
+#ifdef __SSE2__
+	__m128i group = _mm_load_si128((const __m128i *)ctrls);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < WUY_OADICT_GROUP; i++) {
+		if (ctrls[i] == c) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+/* return the bitmask of EMPTY or DELETED slots in the group */
+static uint32_t wuy_oadict_match_free(const uint8_t *ctrls)
+{
+#ifdef __SSE2__
+	__m128i group = _mm_load_si128((const __m128i *)ctrls);
+	return _mm_movemask_epi8(group);
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < WUY_OADICT_GROUP; i++) {
+		if (ctrls[i] & 0x80) {
+			mask |= 1 << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+/* return the slot index of item with the key, or -1 if miss */
+static long wuy_oadict_find(wuy_oadict_t *dict, const void *key,
+		const void *item, uint32_t hash)
+{
+	uint8_t tag = wuy_oadict_tag(hash);
+	uint32_t group = wuy_oadict_group(dict, hash);
+
+	for (uint32_t i = 1; ; i++) {
+		uint32_t base = group * WUY_OADICT_GROUP;
+		const uint8_t *ctrls = dict->ctrls + base;
+
+		uint32_t mask = wuy_oadict_match(ctrls, tag);
+		while (mask != 0) {
+			uint32_t slot = base + __builtin_ctz(mask);
+			void *slot_item = dict->items[slot];
+			if (item != NULL ? slot_item == item
+					: wuy_oadict_equal_key(dict, slot_item, key)) {
+				return slot;
+			}
+			mask &= mask - 1;
+		}
+
+		if (wuy_oadict_match(ctrls, WUY_OADICT_CTRL_EMPTY) != 0) {
+			return -1;
+		}
+		if (i == dict->capacity / WUY_OADICT_GROUP) {
+			return -1;
+		}
+
+		group = wuy_oadict_group_next(dict, group, i);
+	}
+}
+
+/* insert without checking growth */
+static void wuy_oadict_insert(wuy_oadict_t *dict, void *item, uint32_t hash)
+{
+	uint32_t group = wuy_oadict_group(dict, hash);
+
+	for (uint32_t i = 1; ; i++) {
+		uint32_t base = group * WUY_OADICT_GROUP;
+		uint32_t mask = wuy_oadict_match_free(dict->ctrls + base);
+		if (mask != 0) {
+			uint32_t slot = base + __builtin_ctz(mask);
+			if (dict->ctrls[slot] == WUY_OADICT_CTRL_EMPTY) {
+				dict->growth_left--;
+			}
+			dict->ctrls[slot] = wuy_oadict_tag(hash);
+			dict->items[slot] = item;
+			return;
+		}
+		group = wuy_oadict_group_next(dict, group, i);
+	}
+}
+
+static void wuy_oadict_resize(wuy_oadict_t *dict)
+{
+	uint8_t *old_ctrls = dict->ctrls;
+	void **old_items = dict->items;
+	uint32_t old_capacity = dict->capacity;
+
+	/* grow if more than half is in use, otherwise
+	 * there are too many tombstones, so just clean them */
+	uint32_t capacity = old_capacity;
+	if (dict->count >= wuy_oadict_max_load(old_capacity) / 2) {
+		capacity *= 2;
+	}
+
+	wuy_oadict_alloc(dict, capacity);
+
+	for (uint32_t i = 0; i < old_capacity; i++) {
+		if ((old_ctrls[i] & 0x80) == 0) {
+			void *item = old_items[i];
+			wuy_oadict_insert(dict, item, wuy_oadict_hash_item(dict, item));
+		}
+	}
+
+	free(old_ctrls);
+	free(old_items);
+}
+
+void wuy_oadict_add(wuy_oadict_t *dict, void *item)
+{
+	if (dict->growth_left == 0) {
+		wuy_oadict_resize(dict);
+	}
+
+	wuy_oadict_insert(dict, item, wuy_oadict_hash_item(dict, item));
+	dict->count++;
+}
+
+void *_wuy_oadict_get(wuy_oadict_t *dict, const void *key)
+{
+	long slot = wuy_oadict_find(dict, key, NULL, wuy_oadict_hash_key(dict, key));
+	return slot >= 0 ? dict->items[slot] : NULL;
+}
+
+static void wuy_oadict_delete_slot(wuy_oadict_t *dict, uint32_t slot)
+{
+	/* If there is any EMPTY in this group, lookups stop at this
+	 * group anyway, so the slot can be EMPTY too. Otherwise some
+	 * lookups may probe through this group, so we have to leave
+	 * a tombstone here. */
+	const uint8_t *ctrls = dict->ctrls + slot / WUY_OADICT_GROUP * WUY_OADICT_GROUP;
+	if (wuy_oadict_match(ctrls, WUY_OADICT_CTRL_EMPTY) != 0) {
+		dict->ctrls[slot] = WUY_OADICT_CTRL_EMPTY;
+		dict->growth_left++;
+	} else {
+		dict->ctrls[slot] = WUY_OADICT_CTRL_DELETED;
+	}
+
+	dict->count--;
+}
+
+bool wuy_oadict_delete(wuy_oadict_t *dict, void *item)
+{
+	long slot = wuy_oadict_find(dict, NULL, item, wuy_oadict_hash_item(dict, item));
+	if (slot < 0) {
+		return false;
+	}
+	wuy_oadict_delete_slot(dict, slot);
+	return true;
+}
+
+void *_wuy_oadict_del_key(wuy_oadict_t *dict, const void *key)
+{
+	long slot = wuy_oadict_find(dict, key, NULL, wuy_oadict_hash_key(dict, key));
+	if (slot < 0) {
+		return NULL;
+	}
+	void *item = dict->items[slot];
+	wuy_oadict_delete_slot(dict, slot);
+	return item;
+}
+
+size_t wuy_oadict_count(wuy_oadict_t *dict)
+{
+	return dict->count;
+}
+
+void *_wuy_oadict_iter_next(wuy_oadict_t *dict, size_t *pos)
+{
+	while (*pos < dict->capacity) {
+		size_t i = (*pos)++;
+		if ((dict->ctrls[i] & 0x80) == 0) {
+			return dict->items[i];
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file     wuy_oadict.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-22
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * An open addressing dictionary, which is a part of libwuya.
+ *
+ * It works as wuy_dict, but does not chain the items. Instead it
+ * keeps an array of item pointers, and an array of 1-byte metadata
+ * which holds 7 bits of the hash value for each slot. Lookups
+ * probe 16 metadata bytes at a time (with SSE2 if available), and
+ * compare the key only when the hash tag matches. So most lookups
+ * touch 1 or 2 cache lines, hit or miss.
+ *
+ * Since items are not chained, you need not embed any node into
+ * your data struct.
+ */
+
+#ifndef WUY_OADICT_H
+#define WUY_OADICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+
+/**
+ * @brief The dict.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_oadict_s wuy_oadict_t;
+
+/**
+ * @brief Create a dict, with the user-defined key hash/equal function.
+ *
+ * @param key_hash return a 32 bit hash value for the key of item.
+ * @param key_equal return if 2 items have the same key, used for searching.
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_oadict_t *wuy_oadict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal);
+
+/**
+ * @brief Create a dict, with general key type.
+ *
+ * @param key_type see wuy_dict_key_type_e.
+ * @param key_offset the offset of key in your data struct.
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_oadict_t *wuy_oadict_new_type(wuy_dict_key_type_e key_type, size_t key_offset);
+
+/**
+ * @brief Destroy a dict.
+ *
+ * It just frees the dict, but do not releases the items.
+ */
+void wuy_oadict_destroy(wuy_oadict_t *dict);
+
+/**
+ * @brief Add the item into dict.
+ *
+ * It aborts the program if memory allocation fails during growing.
+ */
+void wuy_oadict_add(wuy_oadict_t *dict, void *item);
+
+/**
+ * @brief Search item from dict by the key.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_oadict_get(dict, key) _wuy_oadict_get(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_oadict_get. You should not use this directly. */
+void *_wuy_oadict_get(wuy_oadict_t *dict, const void *key);
+
+/**
+ * @brief Delete the item from dict.
+ *
+ * @return true if success, or false if the item is not in the dict.
+ */
+bool wuy_oadict_delete(wuy_oadict_t *dict, void *item);
+
+/**
+ * @brief Delete a key from dict.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_oadict_del_key(dict, key) _wuy_oadict_del_key(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_oadict_del_key. You should not use this directly. */
+void *_wuy_oadict_del_key(wuy_oadict_t *dict, const void *key);
+
+/**
+ * @brief Return the count of items in dict.
+ */
+size_t wuy_oadict_count(wuy_oadict_t *dict);
+
+/* internal. used by wuy_oadict_iter. */
+void *_wuy_oadict_iter_next(wuy_oadict_t *dict, size_t *pos);
+
+/**
+ * @brief Iterate over a dict. It's safe to delete item during it.
+ */
+#define wuy_oadict_iter(dict, item) \
+	for (size_t _oai = 0; (item = _wuy_oadict_iter_next(dict, &_oai)) != NULL; )
+
+#endif
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/random.h>
+
+#include "wuy_siphash.h"
+#include "wuy_phash.h"
+
+/*
+ * Hash-and-displace: each key gets a 64-bit hash. The low 32 bits
+ * select a bucket, and there are about 4 keys in each bucket. The
+ * buckets are placed from the biggest, by searching a displacement
+ * value for each bucket so that all its keys map to free slots.
+ * The buckets of single key are placed into the remaining free slots
+ * directly, and the slot is stored as a negative displacement.
+ *
+ * Memory layout, all in one allocation:
+ *
+ *   struct wuy_phash_s | int32_t disps[bucket_size] | void *items[count]
+ */
+struct wuy_phash_s {
+	wuy_dict_hash_f		*key_hash;
+	wuy_dict_equal_f	*key_equal;
+	wuy_dict_key_type_e	key_type;
+	size_t			key_offset;
+	size_t			key_len;
+
+	uint8_t			seed[16];
+
+	uint32_t		count;
+	uint32_t		bucket_size;
+	int32_t			*disps;
+	void			**items;
+};
+
+#define WUY_PHASH_BUCKET_KEYS	4
+#define WUY_PHASH_MAX_TRIES	20
+#define WUY_PHASH_MAX_DISP	(1 << 20)
+
+static const void *_item_to_key(wuy_phash_t *phash, const void *item)
+{
+	return (const char *)item + phash->key_offset;
+}
+
+static uint64_t wuy_phash_mix64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+static uint32_t wuy_phash_mix32(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/* map a 32-bit value into [0, n) without division */
+static uint32_t wuy_phash_reduce(uint32_t h, uint32_t n)
+{
+	return ((uint64_t)h * n) >> 32;
+}
+
+static uint64_t wuy_phash_hash_key(wuy_phash_t *phash, const void *key)
+{
+	if (phash->key_hash != NULL) {
+		uint64_t seed;
+		memcpy(&seed, phash->seed, sizeof(seed));
+		return wuy_phash_mix64(phash->key_hash(key) ^ seed);
+	}
+
+	uint64_t buf;
+	size_t len;
+	const void *data = _wuy_dict_type_key_data(phash->key_type,
+			phash->key_len, key, &buf, &len);
+	return wuy_siphash(data, len, phash->seed);
+}
+static uint64_t wuy_phash_hash_item(wuy_phash_t *phash, const void *item)
+{
+	if (phash->key_hash != NULL) {
+		return wuy_phash_hash_key(phash, item);
+	}
+
+	size_t len;
+	const void *data = _wuy_dict_type_item_key_data(phash->key_type,
+			phash->key_len, _item_to_key(phash, item), &len);
+	return wuy_siphash(data, len, phash->seed);
+}
+
+static bool wuy_phash_equal_key(wuy_phash_t *phash, const void *item, const void *key)
+{
+	if (phash->key_equal != NULL) {
+		return phash->key_equal(item, key);
+	}
+	return _wuy_dict_type_equal_key(phash->key_type, phash->key_len,
+			_item_to_key(phash, item), key);
+}
+
+static uint32_t wuy_phash_bucket(wuy_phash_t *phash, uint64_t hash)
+{
+	return wuy_phash_reduce((uint32_t)hash, phash->bucket_size);
+}
+
+static uint32_t wuy_phash_slot(wuy_phash_t *phash, uint64_t hash, int32_t disp)
+{
+	if (disp < 0) {
+		return -disp - 1;
+	}
+	uint32_t h = (uint32_t)(hash >> 32) ^ ((uint32_t)disp * 0x9e3779b9);
+	return wuy_phash_reduce(wuy_phash_mix32(h), phash->count);
+}
+
+struct wuy_phash_build_bucket {
+	uint32_t	index;
+	uint32_t	start;
+	uint32_t	size;
+};
+
+static int wuy_phash_bucket_cmp(const void *a, const void *b)
+{
+	const struct wuy_phash_build_bucket *ba = a, *bb = b;
+	return (int)bb->size - (int)ba->size;
+}
+
+static int wuy_phash_hash_cmp(const void *a, const void *b)
+{
+	uint64_t ha = *(const uint64_t *)a, hb = *(const uint64_t *)b;
+	return ha < hb ? -1 : ha > hb;
+}
+
+/* Equal keys, or keys with equal full hashes, map to the same slot
+ * with any displacement, so the building never succeeds. Check them
+ * once before trying. For user-defined hash, the seed does not help
+ * if the 32-bit hashes are equal. */
+static bool wuy_phash_has_dup(wuy_phash_t *phash, void *const items[], uint64_t *hashes)
+{
+	uint32_t n = phash->count;
+	for (uint32_t i = 0; i < n; i++) {
+		hashes[i] = wuy_phash_hash_item(phash, items[i]);
+	}
+	qsort(hashes, n, sizeof(uint64_t), wuy_phash_hash_cmp);
+	for (uint32_t i = 1; i < n; i++) {
+		if (hashes[i] == hashes[i - 1]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void wuy_phash_seed(wuy_phash_t *phash)
+{
+	if (getrandom(phash->seed, sizeof(phash->seed), 0) != sizeof(phash->seed)) {
+		for (int j = 0; j < sizeof(phash->seed); j++) {
+			phash->seed[j] = random();
+		}
+	}
+}
+
+/* try to build with current seed */
+static bool wuy_phash_try(wuy_phash_t *phash, void *const items[],
+		uint64_t *hashes, uint32_t *order,
+		struct wuy_phash_build_bucket *buckets, bool *used)
+{
+	uint32_t n = phash->count;
+	uint32_t r = phash->bucket_size;
+
+	for (uint32_t i = 0; i < n; i++) {
+		hashes[i] = wuy_phash_hash_item(phash, items[i]);
+	}
+
+	/* group items by bucket, by counting sort */
+	for (uint32_t b = 0; b < r; b++) {
+		buckets[b].index = b;
+		buckets[b].size = 0;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		buckets[wuy_phash_bucket(phash, hashes[i])].size++;
+	}
+	uint32_t start = 0;
+	for (uint32_t b = 0; b < r; b++) {
+		buckets[b].start = start;
+		start += buckets[b].size;
+		buckets[b].size = 0;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		struct wuy_phash_build_bucket *bucket = &buckets[wuy_phash_bucket(phash, hashes[i])];
+		order[bucket->start + bucket->size++] = i;
+	}
+
+	qsort(buckets, r, sizeof(struct wuy_phash_build_bucket), wuy_phash_bucket_cmp);
+
+	memset(used, 0, sizeof(bool) * n);
+	for (uint32_t b = 0; b < r; b++) {
+		phash->disps[buckets[b].index] = 0;
+	}
+
+	/* place the buckets with more than one keys */
+	uint32_t b;
+	for (b = 0; b < r && buckets[b].size > 1; b++) {
+		struct wuy_phash_build_bucket *bucket = &buckets[b];
+		uint32_t *members = &order[bucket->start];
+
+		int32_t disp;
+		for (disp = 0; disp < WUY_PHASH_MAX_DISP; disp++) {
+			uint32_t k;
+			for (k = 0; k < bucket->size; k++) {
+				uint32_t slot = wuy_phash_slot(phash, hashes[members[k]], disp);
+				if (used[slot]) {
+					break;
+				}
+				used[slot] = true;
+			}
+			if (k == bucket->size) {
+				break;
+			}
+			/* roll back */
+			while (k-- > 0) {
+				used[wuy_phash_slot(phash, hashes[members[k]], disp)] = false;
+			}
+		}
+		if (disp == WUY_PHASH_MAX_DISP) {
+			return false;
+		}
+
+		phash->disps[bucket->index] = disp;
+		for (uint32_t k = 0; k < bucket->size; k++) {
+			uint32_t i = members[k];
+			phash->items[wuy_phash_slot(phash, hashes[i], disp)] = items[i];
+		}
+	}
+
+	/* place the buckets with one key into free slots directly */
+	uint32_t slot = 0;
+	for (; b < r && buckets[b].size == 1; b++) {
+		while (used[slot]) {
+			slot++;
+		}
+		used[slot] = true;
+		phash->disps[buckets[b].index] = -(int32_t)slot - 1;
+		phash->items[slot] = items[order[buckets[b].start]];
+	}
+
+	return true;
+}
+
+static wuy_phash_t *wuy_phash_build(wuy_phash_t *tmpl, void *const items[], size_t n)
+{
+	if (n > INT32_MAX) {
+		return NULL;
+	}
+
+	uint32_t r = (n + WUY_PHASH_BUCKET_KEYS - 1) / WUY_PHASH_BUCKET_KEYS;
+	if (r == 0) {
+		r = 1;
+	}
+
+	/* one more pointer for the padding before items */
+	wuy_phash_t *phash = malloc(sizeof(wuy_phash_t) + sizeof(int32_t) * r
+			+ sizeof(void *) * (n + 1));
+	assert(phash != NULL);
+
+	*phash = *tmpl;
+	phash->count = n;
+	phash->bucket_size = r;
+	phash->disps = (int32_t *)(phash + 1);
+	phash->items = (void **)(((uintptr_t)(phash->disps + r) + sizeof(void *) - 1)
+			& ~(uintptr_t)(sizeof(void *) - 1));
+
+	if (n == 0) {
+		phash->disps[0] = 0;
+		return phash;
+	}
+
+	uint64_t *hashes = malloc(sizeof(uint64_t) * n);
+	uint32_t *order = malloc(sizeof(uint32_t) * n);
+	struct wuy_phash_build_bucket *buckets = malloc(sizeof(struct wuy_phash_build_bucket) * r);
+	bool *used = malloc(sizeof(bool) * n);
+	assert(hashes != NULL && order != NULL && buckets != NULL && used != NULL);
+
+	wuy_phash_seed(phash);
+	bool ok = false;
+	if (!wuy_phash_has_dup(phash, items, hashes)) {
+		for (int i = 0; i < WUY_PHASH_MAX_TRIES && !ok; i++) {
+			if (i > 0) {
+				wuy_phash_seed(phash);
+			}
+			ok = wuy_phash_try(phash, items, hashes, order, buckets, used);
+		}
+	}
+
+	free(hashes);
+	free(order);
+	free(buckets);
+	free(used);
+
+	if (!ok) {
+		free(phash);
+		return NULL;
+	}
+	return phash;
+}
+
+wuy_phash_t *wuy_phash_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, void *const items[], size_t n)
+{
+	wuy_phash_t tmpl = {
+		.key_hash = key_hash,
+		.key_equal = key_equal,
+		.key_type = 100,
+	};
+	return wuy_phash_build(&tmpl, items, n);
+}
+
+wuy_phash_t *wuy_phash_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, void *const items[], size_t n)
+{
+	assert(key_type != WUY_DICT_KEY_BINARY);
+
+	wuy_phash_t tmpl = {
+		.key_type = key_type,
+		.key_offset = key_offset,
+	};
+	return wuy_phash_build(&tmpl, items, n);
+}
+
+wuy_phash_t *wuy_phash_new_dict(wuy_dict_t *dict)
+{
+	wuy_phash_t tmpl = { .key_hash = NULL };
+	_wuy_dict_key_settings(dict, &tmpl.key_hash, &tmpl.key_equal,
+			&tmpl.key_type, &tmpl.key_offset, &tmpl.key_len);
+
+	size_t n = wuy_dict_count(dict);
+	void **items = malloc(sizeof(void *) * (n + 1));
+	assert(items != NULL);
+
+	size_t i = 0;
+	wuy_hlist_node_t *node;
+	wuy_dict_iter(dict, node) {
+		items[i++] = wuy_dict_node_item(dict, node);
+	}
+	assert(i == n);
+
+	wuy_phash_t *phash = wuy_phash_build(&tmpl, items, n);
+	free(items);
+	return phash;
+}
+
+void wuy_phash_destroy(wuy_phash_t *phash)
+{
+	free(phash);
+}
+
+void *_wuy_phash_get(wuy_phash_t *phash, const void *key)
+{
+	if (phash->count == 0) {
+		return NULL;
+	}
+
+	uint64_t hash = wuy_phash_hash_key(phash, key);
+	int32_t disp = phash->disps[wuy_phash_bucket(phash, hash)];
+	void *item = phash->items[wuy_phash_slot(phash, hash, disp)];
+	return wuy_phash_equal_key(phash, item, key) ? item : NULL;
+}
+
+void *wuy_phash_get_len(wuy_phash_t *phash, const void *data, size_t len)
+{
+	wuy_dict_lstr_t ls;
+	switch (phash->key_type) {
+	case WUY_DICT_KEY_LSTRING:
+		ls.data = data;
+		ls.len = len;
+		return _wuy_phash_get(phash, &ls);
+	case WUY_DICT_KEY_BINARY:
+		return len == phash->key_len ? _wuy_phash_get(phash, data) : NULL;
+	default:
+		abort();
+	}
+}
+
+size_t wuy_phash_count(wuy_phash_t *phash)
+{
+	return phash->count;
+}
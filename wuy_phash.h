@@ -0,0 +1,104 @@
+/**
+ * @file     wuy_phash.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-28
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * Static minimal perfect hash table, for read-only key sets, e.g.
+ * HTTP header names or configuration enums.
+ *
+ * It's built once from an array of items or from a wuy_dict, by the
+ * hash-and-displace algorithm (CHD-like). Then each searching hashes
+ * the key once, reads one displacement and compares one item. The
+ * table can not be modified after building.
+ *
+ * The items are not copied, and you need not embed any node into
+ * your data struct.
+ */
+
+#ifndef WUY_PHASH_H
+#define WUY_PHASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+
+/**
+ * @brief The table.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_phash_s wuy_phash_t;
+
+/**
+ * @brief Build a table, with the user-defined key hash/equal function.
+ *
+ * The parameters key_hash and key_equal are same with wuy_dict_new_func().
+ * Items whose keys have the same 32-bit hash value can not be built.
+ *
+ * @param items the array of items, which is not referred after building.
+ * @param n the number of items.
+ *
+ * @return the new table, or NULL if fails, e.g. duplicate keys.
+ */
+wuy_phash_t *wuy_phash_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, void *const items[], size_t n);
+
+/**
+ * @brief Build a table, with general key type.
+ *
+ * The parameters key_type and key_offset are same with wuy_dict_new_type().
+ * WUY_DICT_KEY_BINARY is not supported here, use wuy_phash_new_dict() instead.
+ *
+ * @param items the array of items, which is not referred after building.
+ * @param n the number of items.
+ *
+ * @return the new table, or NULL if fails, e.g. duplicate keys.
+ */
+wuy_phash_t *wuy_phash_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, void *const items[], size_t n);
+
+/**
+ * @brief Build a table with all items in the dict, with the same key settings.
+ *
+ * The dict is not changed, and can be destroyed after building.
+ *
+ * @return the new table, or NULL if fails.
+ */
+wuy_phash_t *wuy_phash_new_dict(wuy_dict_t *dict);
+
+/**
+ * @brief Destroy the table. The items are not released.
+ */
+void wuy_phash_destroy(wuy_phash_t *phash);
+
+/**
+ * @brief Search item from table by the key.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_phash_get(phash, key) _wuy_phash_get(phash, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_phash_get. You should not use this directly. */
+void *_wuy_phash_get(wuy_phash_t *phash, const void *key);
+
+/**
+ * @brief Search item from table by the key of (data, len).
+ *
+ * Same with wuy_dict_get_len().
+ */
+void *wuy_phash_get_len(wuy_phash_t *phash, const void *data, size_t len);
+
+/**
+ * @brief Return the count of items in table.
+ */
+size_t wuy_phash_count(wuy_phash_t *phash);
+
+#endif
@@ -0,0 +1,243 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "wuy_radix_heap.h"
+
+/*
+ * Bucket 0 holds the items whose key equals to last, and bucket i
+ * (1 <= i <= 64) holds the items whose key differs from last at bit
+ * i-1 at most. So the keys in lower buckets are always less.
+ *
+ * When bucket 0 is empty, the lowest non-empty bucket is emptied by
+ * setting last to its min key and re-pushing its items, which all
+ * fall into lower buckets. Each item moves down at most 64 times.
+ *
+ * The min node of the lowest non-empty bucket (except bucket 0) is
+ * cached, so peeking need not scan the bucket. The cache is kept in
+ * linking, and dropped only if the cached node is unlinked.
+ */
+#define WUY_RADIX_HEAP_BUCKETS	65
+
+struct wuy_radix_heap_s {
+	wuy_heap_key_type_e	key_type;
+	size_t			key_offset;
+	size_t			node_offset;
+
+	uint64_t		last;
+	size_t			count;
+
+	/* bit i-1 is set if bucket i is not empty, for i >= 1 */
+	uint64_t		bitmap;
+
+	/* min node of the lowest non-empty bucket, NULL if unknown */
+	wuy_radix_heap_node_t	*lowest_min;
+	wuy_list_t		buckets[WUY_RADIX_HEAP_BUCKETS];
+};
+
+wuy_radix_heap_t *wuy_radix_heap_new_type(wuy_heap_key_type_e key_type,
+		size_t key_offset, size_t node_offset)
+{
+	assert(key_type == WUY_HEAP_KEY_UINT32 || key_type == WUY_HEAP_KEY_UINT64);
+
+	wuy_radix_heap_t *heap = malloc(sizeof(wuy_radix_heap_t));
+	assert(heap != NULL);
+
+	heap->key_type = key_type;
+	heap->key_offset = key_offset;
+	heap->node_offset = node_offset;
+	heap->last = 0;
+	heap->count = 0;
+	heap->bitmap = 0;
+	heap->lowest_min = NULL;
+	for (int i = 0; i < WUY_RADIX_HEAP_BUCKETS; i++) {
+		wuy_list_init(&heap->buckets[i]);
+	}
+	return heap;
+}
+
+void wuy_radix_heap_destroy(wuy_radix_heap_t *heap)
+{
+	free(heap);
+}
+
+static wuy_radix_heap_node_t *_item_to_node(wuy_radix_heap_t *heap, const void *item)
+{
+	return (wuy_radix_heap_node_t *)((char *)item + heap->node_offset);
+}
+static void *_node_to_item(wuy_radix_heap_t *heap, wuy_radix_heap_node_t *node)
+{
+	return (char *)node - heap->node_offset;
+}
+static uint64_t _node_to_key(wuy_radix_heap_t *heap, wuy_radix_heap_node_t *node)
+{
+	const char *pk = (const char *)_node_to_item(heap, node) + heap->key_offset;
+	if (heap->key_type == WUY_HEAP_KEY_UINT32) {
+		return *(const uint32_t *)pk;
+	}
+	return *(const uint64_t *)pk;
+}
+
+static int wuy_radix_heap_bucket(wuy_radix_heap_t *heap, uint64_t key)
+{
+	uint64_t diff = key ^ heap->last;
+	return diff == 0 ? 0 : 64 - __builtin_clzll(diff);
+}
+
+static void wuy_radix_heap_link(wuy_radix_heap_t *heap, wuy_radix_heap_node_t *node)
+{
+	uint64_t key = _node_to_key(heap, node);
+	assert(key >= heap->last);
+
+	int bucket = wuy_radix_heap_bucket(heap, key);
+	node->bucket = bucket;
+	wuy_list_append(&heap->buckets[bucket], &node->list_node);
+	if (bucket == 0) {
+		return;
+	}
+
+	/* update the cache */
+	wuy_radix_heap_node_t *min = heap->lowest_min;
+	if (min != NULL) {
+		if (bucket < min->bucket || (bucket == min->bucket
+					&& key < _node_to_key(heap, min))) {
+			heap->lowest_min = node;
+		}
+	} else if ((heap->bitmap << (64 - bucket)) == 0) {
+		/* no node in this bucket and lower ones before */
+		heap->lowest_min = node;
+	}
+
+	heap->bitmap |= 1ULL << (bucket - 1);
+}
+
+static void wuy_radix_heap_unlink(wuy_radix_heap_t *heap, wuy_radix_heap_node_t *node)
+{
+	wuy_list_delete(&node->list_node);
+
+	if (node == heap->lowest_min) {
+		heap->lowest_min = NULL;
+	}
+
+	int bucket = node->bucket;
+	if (bucket > 0 && wuy_list_empty(&heap->buckets[bucket])) {
+		heap->bitmap &= ~(1ULL << (bucket - 1));
+	}
+}
+
+void wuy_radix_heap_push(wuy_radix_heap_t *heap, void *item)
+{
+	wuy_radix_heap_node_t *node = _item_to_node(heap, item);
+	assert(!wuy_list_node_linked(&node->list_node));
+
+	wuy_radix_heap_link(heap, node);
+	heap->count++;
+}
+
+/* return the min node in the lowest non-empty bucket */
+static wuy_radix_heap_node_t *wuy_radix_heap_lowest(wuy_radix_heap_t *heap)
+{
+	wuy_radix_heap_node_t *node;
+	if (wuy_list_first_type(&heap->buckets[0], node, list_node) != NULL) {
+		return node;
+	}
+	if (heap->bitmap == 0) {
+		return NULL;
+	}
+
+	if (heap->lowest_min != NULL) {
+		return heap->lowest_min;
+	}
+
+	int bucket = __builtin_ctzll(heap->bitmap) + 1;
+	wuy_radix_heap_node_t *min_node = NULL;
+	uint64_t min = UINT64_MAX;
+	wuy_list_iter_type(&heap->buckets[bucket], node, list_node) {
+		uint64_t key = _node_to_key(heap, node);
+		if (min_node == NULL || key < min) {
+			min_node = node;
+			min = key;
+		}
+	}
+	heap->lowest_min = min_node;
+	return min_node;
+}
+
+/* Make sure bucket 0 is not empty, unless the heap is empty.
+ * Only popping calls this, because it moves forward last. */
+static void wuy_radix_heap_redistribute(wuy_radix_heap_t *heap)
+{
+	if (!wuy_list_empty(&heap->buckets[0]) || heap->bitmap == 0) {
+		return;
+	}
+
+	int bucket = __builtin_ctzll(heap->bitmap) + 1;
+	wuy_list_t *list = &heap->buckets[bucket];
+
+	wuy_radix_heap_node_t *node = wuy_radix_heap_lowest(heap);
+	heap->last = _node_to_key(heap, node);
+	heap->bitmap &= ~(1ULL << (bucket - 1));
+	heap->lowest_min = NULL;
+
+	wuy_list_t tmp;
+	wuy_list_init(&tmp);
+	wuy_list_node_t *lnode;
+	while ((lnode = wuy_list_pop(list)) != NULL) {
+		wuy_list_append(&tmp, lnode);
+	}
+	while (wuy_list_pop_type(&tmp, node, list_node) != NULL) {
+		wuy_radix_heap_link(heap, node);
+	}
+}
+
+/* Do not redistribute here, otherwise last would be moved forward
+ * without popping, and then the keys between the last popped one
+ * and the current min could not be pushed. */
+void *wuy_radix_heap_min(wuy_radix_heap_t *heap)
+{
+	wuy_radix_heap_node_t *node = wuy_radix_heap_lowest(heap);
+	return node != NULL ? _node_to_item(heap, node) : NULL;
+}
+
+void *wuy_radix_heap_pop(wuy_radix_heap_t *heap)
+{
+	wuy_radix_heap_redistribute(heap);
+
+	wuy_radix_heap_node_t *node;
+	if (wuy_list_pop_type(&heap->buckets[0], node, list_node) == NULL) {
+		return NULL;
+	}
+	heap->count--;
+	return _node_to_item(heap, node);
+}
+
+void wuy_radix_heap_fix(wuy_radix_heap_t *heap, void *item)
+{
+	wuy_radix_heap_node_t *node = _item_to_node(heap, item);
+	assert(wuy_list_node_linked(&node->list_node));
+
+	wuy_radix_heap_unlink(heap, node);
+	wuy_radix_heap_link(heap, node);
+}
+
+bool wuy_radix_heap_delete(wuy_radix_heap_t *heap, void *item)
+{
+	wuy_radix_heap_node_t *node = _item_to_node(heap, item);
+	if (!wuy_list_node_linked(&node->list_node)) {
+		return false;
+	}
+
+	wuy_radix_heap_unlink(heap, node);
+	heap->count--;
+	return true;
+}
+
+uint64_t wuy_radix_heap_last(wuy_radix_heap_t *heap)
+{
+	return heap->last;
+}
+
+size_t wuy_radix_heap_count(wuy_radix_heap_t *heap)
+{
+	return heap->count;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file     wuy_radix_heap.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-8-3
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * Radix heap, a monotone priority queue for integer keys, e.g.
+ * timestamps of timers.
+ *
+ * It is monotone: the keys pushed must not be less than the last
+ * popped key. In exchange, push, delete and decrease-key are O(1),
+ * and pop is amortized O(log(C)) where C is the key range, with only
+ * integer operations and no comparison of items during sifting.
+ *
+ * The items are kept in 65 buckets by the highest bit that differs
+ * from the last popped key. Popping redistributes one bucket into
+ * lower buckets only when the lowest one is empty.
+ */
+
+#ifndef WUY_RADIX_HEAP_H
+#define WUY_RADIX_HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wuy_list.h"
+#include "wuy_heap.h"
+
+/**
+ * @brief The heap.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_radix_heap_s wuy_radix_heap_t;
+
+/**
+ * @brief Embed this node into your data struct in order to use this lib.
+ *
+ * You MUST initialize it by wuy_radix_heap_node_init() or zero before
+ * used, and need not touch it later.
+ */
+typedef struct {
+	wuy_list_node_t	list_node;
+	int		bucket;
+} wuy_radix_heap_node_t;
+
+/**
+ * @brief Create a new heap.
+ *
+ * @param key_type WUY_HEAP_KEY_UINT32 or WUY_HEAP_KEY_UINT64 only.
+ * @param key_offset the offset of key in your data struct.
+ * @param node_offset the offset of wuy_radix_heap_node_t in your data struct.
+ *
+ * @return the new heap. It aborts the program if memory allocation fails.
+ */
+wuy_radix_heap_t *wuy_radix_heap_new_type(wuy_heap_key_type_e key_type,
+		size_t key_offset, size_t node_offset);
+
+/**
+ * @brief Destroy the heap. The items are not released.
+ */
+void wuy_radix_heap_destroy(wuy_radix_heap_t *heap);
+
+/**
+ * @brief Initialize the node.
+ */
+static inline void wuy_radix_heap_node_init(wuy_radix_heap_node_t *node)
+{
+	node->list_node.next = node->list_node.prev = NULL;
+}
+
+/**
+ * @brief Add an item into the heap.
+ *
+ * @note It aborts if the item is in the heap already, or its key is
+ * less than the last popped key.
+ */
+void wuy_radix_heap_push(wuy_radix_heap_t *heap, void *item);
+
+/**
+ * @brief Pop and return the min item, or NULL if empty.
+ */
+void *wuy_radix_heap_pop(wuy_radix_heap_t *heap);
+
+/**
+ * @brief Return the min item but not delete it, or NULL if empty.
+ *
+ * It's O(1) usually. Only after the min item is deleted or fixed, it
+ * scans the lowest bucket once.
+ */
+void *wuy_radix_heap_min(wuy_radix_heap_t *heap);
+
+/**
+ * @brief Fix an item in the heap after changing its key, e.g. decrease-key.
+ *
+ * @note It aborts if the item is not in the heap, or its new key is
+ * less than the last popped key.
+ */
+void wuy_radix_heap_fix(wuy_radix_heap_t *heap, void *item);
+
+/**
+ * @brief Delete the item from heap.
+ *
+ * @return true if success, or false if the item is not in the heap.
+ */
+bool wuy_radix_heap_delete(wuy_radix_heap_t *heap, void *item);
+
+/**
+ * @brief Return the last popped key, which is the lower bound of the
+ * keys that can be pushed.
+ */
+uint64_t wuy_radix_heap_last(wuy_radix_heap_t *heap);
+
+/**
+ * @brief Return the count of items in heap.
+ */
+size_t wuy_radix_heap_count(wuy_radix_heap_t *heap);
+
+#endif
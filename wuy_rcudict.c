@@ -0,0 +1,478 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "wuy_rcudict.h"
+
+/*
+ * Items are referred by cells which are chained in buckets.
+ * Writers publish new cells and buckets by release-store, and
+ * readers follow them by acquire-load.
+ *
+ * During expansion, the new table refers to the previous table.
+ * Each write operation copies the cells of one previous bucket
+ * into the new table, while the previous table is kept intact
+ * for readers who are still searching it. When all buckets are
+ * copied, the previous table is retired, and freed after all
+ * readers pass a quiescent state.
+ */
+struct wuy_rcudict_cell {
+	struct wuy_rcudict_cell		*next;
+	uint32_t			hash;
+	void				*item;
+};
+
+struct wuy_rcudict_table {
+	struct wuy_rcudict_table	*prev;
+	uint32_t			size;
+	struct wuy_rcudict_cell		*buckets[0];
+};
+
+struct wuy_rcudict_retired {
+	struct wuy_rcudict_retired	*next;
+	uint64_t			epoch;
+	void				(*handler)(void *);
+	void				*ptr;
+};
+
+struct wuy_rcudict_reader_s {
+	wuy_rcudict_reader_t		*next;
+	wuy_rcudict_t			*dict;
+	uint64_t			seen;
+};
+
+struct wuy_rcudict_s {
+	wuy_dict_hash_f			*key_hash;
+	wuy_dict_equal_f		*key_equal;
+	wuy_dict_key_type_e		key_type;
+	size_t				key_offset;
+
+	struct wuy_rcudict_table	*table;
+
+	/* the following are protected by writer_lock */
+	pthread_mutex_t			writer_lock;
+
+	uint32_t			split;
+	size_t				count;
+
+	wuy_rcudict_free_f		*free_handler;
+
+	uint64_t			gp_seq;
+	wuy_rcudict_reader_t		*readers;
+	struct wuy_rcudict_retired	*retired_head;
+	struct wuy_rcudict_retired	**retired_tail;
+};
+
+#define WUY_RCUDICT_SIZE_INIT		64
+#define WUY_RCUDICT_SIZE_MAX		(64*1024*1024)
+#define WUY_RCUDICT_EXPANSION_FACTOR	2
+
+#define WUY_RCUDICT_OFFLINE		UINT64_MAX
+
+#define _load(p)	__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define _store(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+static struct wuy_rcudict_table *wuy_rcudict_table_new(uint32_t size)
+{
+	struct wuy_rcudict_table *table = calloc(1, sizeof(struct wuy_rcudict_table)
+			+ sizeof(struct wuy_rcudict_cell *) * size);
+	if (table != NULL) {
+		table->size = size;
+	}
+	return table;
+}
+
+static void wuy_rcudict_table_free(void *p)
+{
+	struct wuy_rcudict_table *table = p;
+	for (uint32_t i = 0; i < table->size; i++) {
+		struct wuy_rcudict_cell *cell, *next;
+		for (cell = table->buckets[i]; cell != NULL; cell = next) {
+			next = cell->next;
+			free(cell);
+		}
+	}
+	free(table);
+}
+
+static wuy_rcudict_t *wuy_rcudict_new(void)
+{
+	wuy_rcudict_t *dict = calloc(1, sizeof(wuy_rcudict_t));
+	assert(dict != NULL);
+
+	dict->table = wuy_rcudict_table_new(WUY_RCUDICT_SIZE_INIT);
+	assert(dict->table != NULL);
+
+	pthread_mutex_init(&dict->writer_lock, NULL);
+	dict->retired_tail = &dict->retired_head;
+	return dict;
+}
+
+wuy_rcudict_t *wuy_rcudict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal)
+{
+	wuy_rcudict_t *dict = wuy_rcudict_new();
+	dict->key_hash = key_hash;
+	dict->key_equal = key_equal;
+	dict->key_type = 100;
+	dict->key_offset = 0;
+	return dict;
+}
+
+wuy_rcudict_t *wuy_rcudict_new_type(wuy_dict_key_type_e key_type, size_t key_offset)
+{
+	/* no key length here */
+	assert(key_type != WUY_DICT_KEY_BINARY);
+
+	wuy_rcudict_t *dict = wuy_rcudict_new();
+	dict->key_hash = NULL;
+	dict->key_equal = NULL;
+	dict->key_type = key_type;
+	dict->key_offset = key_offset;
+	return dict;
+}
+
+void wuy_rcudict_destroy(wuy_rcudict_t *dict)
+{
+	struct wuy_rcudict_retired *r;
+	while ((r = dict->retired_head) != NULL) {
+		dict->retired_head = r->next;
+		r->handler(r->ptr);
+		free(r);
+	}
+
+	wuy_rcudict_reader_t *reader;
+	while ((reader = dict->readers) != NULL) {
+		dict->readers = reader->next;
+		free(reader);
+	}
+
+	if (dict->table->prev != NULL) {
+		wuy_rcudict_table_free(dict->table->prev);
+	}
+	wuy_rcudict_table_free(dict->table);
+
+	pthread_mutex_destroy(&dict->writer_lock);
+	free(dict);
+}
+
+void wuy_rcudict_set_free(wuy_rcudict_t *dict, wuy_rcudict_free_f *handler)
+{
+	dict->free_handler = handler;
+}
+
+static const void *_item_to_key(wuy_rcudict_t *dict, const void *item)
+{
+	return (const char *)item + dict->key_offset;
+}
+
+static uint32_t wuy_rcudict_hash_key(wuy_rcudict_t *dict, const void *key)
+{
+	if (dict->key_hash != NULL) {
+		return dict->key_hash(key);
+	}
+	return _wuy_dict_type_hash_key(dict->key_type, 0, key);
+}
+static uint32_t wuy_rcudict_hash_item(wuy_rcudict_t *dict, const void *item)
+{
+	if (dict->key_hash != NULL) {
+		return dict->key_hash(item);
+	}
+	return _wuy_dict_type_hash_item_key(dict->key_type, 0, _item_to_key(dict, item));
+}
+
+static bool wuy_rcudict_equal_key(wuy_rcudict_t *dict, const void *item, const void *key)
+{
+	if (dict->key_equal != NULL) {
+		return dict->key_equal(item, key);
+	}
+	return _wuy_dict_type_equal_key(dict->key_type, 0, _item_to_key(dict, item), key);
+}
+
+static struct wuy_rcudict_cell **wuy_rcudict_bucket(struct wuy_rcudict_table *table,
+		uint32_t hash)
+{
+	return &table->buckets[hash & (table->size - 1)];
+}
+
+static void *wuy_rcudict_search_bucket(wuy_rcudict_t *dict,
+		struct wuy_rcudict_cell **bucket, const void *key, uint32_t hash)
+{
+	for (struct wuy_rcudict_cell *cell = _load(bucket); cell != NULL;
+			cell = _load(&cell->next)) {
+		if (cell->hash == hash && wuy_rcudict_equal_key(dict, cell->item, key)) {
+			return cell->item;
+		}
+	}
+	return NULL;
+}
+
+void *_wuy_rcudict_get(wuy_rcudict_t *dict, const void *key)
+{
+	uint32_t hash = wuy_rcudict_hash_key(dict, key);
+
+	struct wuy_rcudict_table *table = _load(&dict->table);
+
+	/* Load prev before searching table. If it's NULL, then the
+	 * expansion has finished and all cells are in table already. */
+	struct wuy_rcudict_table *prev = _load(&table->prev);
+
+	void *item = wuy_rcudict_search_bucket(dict,
+			wuy_rcudict_bucket(table, hash), key, hash);
+	if (item == NULL && prev != NULL) {
+		item = wuy_rcudict_search_bucket(dict,
+				wuy_rcudict_bucket(prev, hash), key, hash);
+	}
+	return item;
+}
+
+/* the followings are called by writers with writer_lock held */
+
+static void wuy_rcudict_retire(wuy_rcudict_t *dict, void (*handler)(void *), void *ptr)
+{
+	struct wuy_rcudict_retired *r = malloc(sizeof(struct wuy_rcudict_retired));
+	assert(r != NULL);
+
+	__atomic_store_n(&dict->gp_seq, dict->gp_seq + 1, __ATOMIC_SEQ_CST);
+
+	r->epoch = dict->gp_seq;
+	r->handler = handler;
+	r->ptr = ptr;
+	r->next = NULL;
+	*dict->retired_tail = r;
+	dict->retired_tail = &r->next;
+}
+
+/* release the retired memory which all readers have passed */
+static bool wuy_rcudict_reclaim(wuy_rcudict_t *dict)
+{
+	if (dict->retired_head == NULL) {
+		return true;
+	}
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	uint64_t min_seen = WUY_RCUDICT_OFFLINE;
+	for (wuy_rcudict_reader_t *reader = dict->readers; reader != NULL;
+			reader = reader->next) {
+		uint64_t seen = _load(&reader->seen);
+		if (seen < min_seen) {
+			min_seen = seen;
+		}
+	}
+
+	struct wuy_rcudict_retired *r;
+	while ((r = dict->retired_head) != NULL && r->epoch <= min_seen) {
+		dict->retired_head = r->next;
+		r->handler(r->ptr);
+		free(r);
+	}
+	if (dict->retired_head == NULL) {
+		dict->retired_tail = &dict->retired_head;
+		return true;
+	}
+	return false;
+}
+
+static void wuy_rcudict_insert(struct wuy_rcudict_table *table, void *item, uint32_t hash)
+{
+	struct wuy_rcudict_cell *cell = malloc(sizeof(struct wuy_rcudict_cell));
+	assert(cell != NULL);
+
+	struct wuy_rcudict_cell **bucket = wuy_rcudict_bucket(table, hash);
+	cell->hash = hash;
+	cell->item = item;
+	cell->next = *bucket;
+	_store(bucket, cell);
+}
+
+static struct wuy_rcudict_cell *wuy_rcudict_unlink(struct wuy_rcudict_table *table,
+		void *item, uint32_t hash)
+{
+	struct wuy_rcudict_cell *cell, **pnext = wuy_rcudict_bucket(table, hash);
+	for (cell = *pnext; cell != NULL; pnext = &cell->next, cell = *pnext) {
+		if (cell->item == item) {
+			_store(pnext, cell->next);
+			return cell;
+		}
+	}
+	return NULL;
+}
+
+static void wuy_rcudict_expasion(wuy_rcudict_t *dict)
+{
+	struct wuy_rcudict_table *table = dict->table;
+
+	/* expansion */
+	if (dict->count >= (size_t)table->size * WUY_RCUDICT_EXPANSION_FACTOR
+			&& table->prev == NULL
+			&& table->size < WUY_RCUDICT_SIZE_MAX) {
+
+		struct wuy_rcudict_table *newt = wuy_rcudict_table_new(table->size * 2);
+		if (newt == NULL) {
+			/* if calloc fails, do nothing */
+			return;
+		}
+		newt->prev = table;
+		_store(&dict->table, newt);
+		dict->split = 0;
+		return;
+	}
+
+	/* copy a bucket */
+	struct wuy_rcudict_table *prev = table->prev;
+	if (prev != NULL) {
+		for (struct wuy_rcudict_cell *cell = prev->buckets[dict->split];
+				cell != NULL; cell = cell->next) {
+			wuy_rcudict_insert(table, cell->item, cell->hash);
+		}
+		dict->split++;
+		if (dict->split == prev->size) {
+			/* expansion finish */
+			_store(&table->prev, NULL);
+			wuy_rcudict_retire(dict, wuy_rcudict_table_free, prev);
+		}
+	}
+}
+
+static bool wuy_rcudict_delete_locked(wuy_rcudict_t *dict, void *item, uint32_t hash)
+{
+	struct wuy_rcudict_table *table = dict->table;
+
+	/* the item may be in both table and table->prev during expansion */
+	bool found = false;
+	struct wuy_rcudict_table *tables[2] = { table, table->prev };
+	for (int i = 0; i < 2 && tables[i] != NULL; i++) {
+		struct wuy_rcudict_cell *cell = wuy_rcudict_unlink(tables[i], item, hash);
+		if (cell != NULL) {
+			wuy_rcudict_retire(dict, free, cell);
+			found = true;
+		}
+	}
+	if (!found) {
+		return false;
+	}
+
+	if (dict->free_handler != NULL) {
+		wuy_rcudict_retire(dict, dict->free_handler, item);
+	}
+
+	/* written by the only writer, and read by wuy_rcudict_count() */
+	__atomic_store_n(&dict->count, dict->count - 1, __ATOMIC_RELAXED);
+	wuy_rcudict_expasion(dict);
+	wuy_rcudict_reclaim(dict);
+	return true;
+}
+
+void wuy_rcudict_add(wuy_rcudict_t *dict, void *item)
+{
+	uint32_t hash = wuy_rcudict_hash_item(dict, item);
+
+	pthread_mutex_lock(&dict->writer_lock);
+
+	wuy_rcudict_insert(dict->table, item, hash);
+	__atomic_store_n(&dict->count, dict->count + 1, __ATOMIC_RELAXED);
+	wuy_rcudict_expasion(dict);
+	wuy_rcudict_reclaim(dict);
+
+	pthread_mutex_unlock(&dict->writer_lock);
+}
+
+bool wuy_rcudict_delete(wuy_rcudict_t *dict, void *item)
+{
+	uint32_t hash = wuy_rcudict_hash_item(dict, item);
+
+	pthread_mutex_lock(&dict->writer_lock);
+	bool ret = wuy_rcudict_delete_locked(dict, item, hash);
+	pthread_mutex_unlock(&dict->writer_lock);
+
+	return ret;
+}
+
+void *_wuy_rcudict_del_key(wuy_rcudict_t *dict, const void *key)
+{
+	uint32_t hash = wuy_rcudict_hash_key(dict, key);
+
+	pthread_mutex_lock(&dict->writer_lock);
+
+	/* writers are serialized, so it's safe to search here */
+	void *item = _wuy_rcudict_get(dict, key);
+	if (item != NULL) {
+		wuy_rcudict_delete_locked(dict, item, hash);
+	}
+
+	pthread_mutex_unlock(&dict->writer_lock);
+
+	return item;
+}
+
+wuy_rcudict_reader_t *wuy_rcudict_reader_register(wuy_rcudict_t *dict)
+{
+	wuy_rcudict_reader_t *reader = malloc(sizeof(wuy_rcudict_reader_t));
+	assert(reader != NULL);
+
+	reader->dict = dict;
+
+	pthread_mutex_lock(&dict->writer_lock);
+	reader->seen = dict->gp_seq;
+	reader->next = dict->readers;
+	dict->readers = reader;
+	pthread_mutex_unlock(&dict->writer_lock);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return reader;
+}
+
+void wuy_rcudict_reader_unregister(wuy_rcudict_t *dict, wuy_rcudict_reader_t *reader)
+{
+	pthread_mutex_lock(&dict->writer_lock);
+
+	wuy_rcudict_reader_t **pnext;
+	for (pnext = &dict->readers; *pnext != reader; pnext = &(*pnext)->next);
+	*pnext = reader->next;
+	free(reader);
+
+	wuy_rcudict_reclaim(dict);
+
+	pthread_mutex_unlock(&dict->writer_lock);
+}
+
+void wuy_rcudict_quiescent(wuy_rcudict_reader_t *reader)
+{
+	_store(&reader->seen, _load(&reader->dict->gp_seq));
+}
+
+void wuy_rcudict_reader_offline(wuy_rcudict_reader_t *reader)
+{
+	_store(&reader->seen, WUY_RCUDICT_OFFLINE);
+}
+
+void wuy_rcudict_reader_online(wuy_rcudict_reader_t *reader)
+{
+	_store(&reader->seen, _load(&reader->dict->gp_seq));
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void wuy_rcudict_synchronize(wuy_rcudict_t *dict)
+{
+	while (1) {
+		pthread_mutex_lock(&dict->writer_lock);
+		bool done = wuy_rcudict_reclaim(dict);
+		pthread_mutex_unlock(&dict->writer_lock);
+
+		if (done) {
+			return;
+		}
+		sched_yield();
+	}
+}
+
+size_t wuy_rcudict_count(wuy_rcudict_t *dict)
+{
+	return __atomic_load_n(&dict->count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,178 @@
+/**
+ * @file     wuy_rcudict.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-22
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * A read-mostly dictionary, which is a part of libwuya.
+ *
+ * Searching runs without any lock or atomic read-modify-write, so
+ * it scales with reader threads. Writers (add and delete) are
+ * serialized by a mutex.
+ *
+ * Memory is reclaimed by QSBR (quiescent-state-based reclamation):
+ * each reader thread registers itself by wuy_rcudict_reader_register(),
+ * and calls wuy_rcudict_quiescent() periodically at some point where
+ * it holds no item got from the dict, e.g. at each loop of the event
+ * loop. Deleted items, and the internal memory, are released only
+ * after all registered readers pass a quiescent state.
+ *
+ * The dict expands incrementally as wuy_dict, while the new buckets
+ * are published before the old ones are retired, so readers always
+ * find the items.
+ *
+ * Items are not chained, so you need not embed any node into your
+ * data struct.
+ */
+
+#ifndef WUY_RCUDICT_H
+#define WUY_RCUDICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+
+/**
+ * @brief The dict.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_rcudict_s wuy_rcudict_t;
+
+/**
+ * @brief A registered reader thread.
+ */
+typedef struct wuy_rcudict_reader_s wuy_rcudict_reader_t;
+
+/**
+ * @brief Release a deleted item, called after a grace period.
+ */
+typedef void wuy_rcudict_free_f(void *item);
+
+/**
+ * @brief Create a dict, with the user-defined key hash/equal function.
+ *
+ * The parameters are same with wuy_oadict_new_func().
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_rcudict_t *wuy_rcudict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal);
+
+/**
+ * @brief Create a dict, with general key type.
+ *
+ * The parameters are same with wuy_oadict_new_type().
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_rcudict_t *wuy_rcudict_new_type(wuy_dict_key_type_e key_type, size_t key_offset);
+
+/**
+ * @brief Destroy a dict.
+ *
+ * There MUST be no reader at this time. Pending deleted items are
+ * released by the free handler if set.
+ */
+void wuy_rcudict_destroy(wuy_rcudict_t *dict);
+
+/**
+ * @brief Set the handler to release deleted items after grace period.
+ *
+ * If not set, you have to call wuy_rcudict_synchronize() before
+ * releasing the deleted items by yourself.
+ */
+void wuy_rcudict_set_free(wuy_rcudict_t *dict, wuy_rcudict_free_f *handler);
+
+/**
+ * @brief Register current thread as a reader.
+ *
+ * You MUST register before calling wuy_rcudict_get() in a thread.
+ */
+wuy_rcudict_reader_t *wuy_rcudict_reader_register(wuy_rcudict_t *dict);
+
+/**
+ * @brief Unregister a reader.
+ */
+void wuy_rcudict_reader_unregister(wuy_rcudict_t *dict, wuy_rcudict_reader_t *reader);
+
+/**
+ * @brief Report a quiescent state of the reader.
+ *
+ * The items got from the dict before this MUST NOT be used after this.
+ */
+void wuy_rcudict_quiescent(wuy_rcudict_reader_t *reader);
+
+/**
+ * @brief Mark the reader offline, e.g. before blocking for a long time.
+ *
+ * An offline reader does not delay the reclamation, but MUST NOT
+ * call wuy_rcudict_get() until wuy_rcudict_reader_online().
+ */
+void wuy_rcudict_reader_offline(wuy_rcudict_reader_t *reader);
+
+/**
+ * @brief Mark the reader online again.
+ */
+void wuy_rcudict_reader_online(wuy_rcudict_reader_t *reader);
+
+/**
+ * @brief Add the item into dict. Writers are serialized.
+ */
+void wuy_rcudict_add(wuy_rcudict_t *dict, void *item);
+
+/**
+ * @brief Search item from dict by the key, without any lock.
+ *
+ * Current thread MUST be a registered online reader, and the item is
+ * valid until the next wuy_rcudict_quiescent().
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_rcudict_get(dict, key) _wuy_rcudict_get(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_rcudict_get. You should not use this directly. */
+void *_wuy_rcudict_get(wuy_rcudict_t *dict, const void *key);
+
+/**
+ * @brief Delete the item from dict. Writers are serialized.
+ *
+ * The item is released by the free handler after a grace period.
+ *
+ * @return true if success, or false if the item is not in the dict.
+ */
+bool wuy_rcudict_delete(wuy_rcudict_t *dict, void *item);
+
+/**
+ * @brief Delete a key from dict. Writers are serialized.
+ *
+ * The item is released by the free handler after a grace period.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_rcudict_del_key(dict, key) _wuy_rcudict_del_key(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_rcudict_del_key. You should not use this directly. */
+void *_wuy_rcudict_del_key(wuy_rcudict_t *dict, const void *key);
+
+/**
+ * @brief Wait for a grace period, and reclaim all deleted memory.
+ *
+ * @note The calling thread MUST NOT be an online reader, otherwise
+ * it waits forever.
+ */
+void wuy_rcudict_synchronize(wuy_rcudict_t *dict);
+
+/**
+ * @brief Return the count of items in dict.
+ */
+size_t wuy_rcudict_count(wuy_rcudict_t *dict);
+
+#endif
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "wuy_sdict.h"
+
+/* aligned to cache line to avoid false sharing between shards */
+struct wuy_sdict_shard {
+	pthread_mutex_t		lock;
+	wuy_dict_t		*dict;
+} __attribute__((aligned(64)));
+
+struct wuy_sdict_s {
+	int			shard_bits;
+	struct wuy_sdict_shard	*shards;
+};
+
+static wuy_sdict_t *wuy_sdict_new(int shards)
+{
+	wuy_sdict_t *sdict = malloc(sizeof(wuy_sdict_t));
+	assert(sdict != NULL);
+
+	int bits = 0;
+	while ((1 << bits) < shards) {
+		bits++;
+	}
+	sdict->shard_bits = bits;
+
+	sdict->shards = aligned_alloc(64, sizeof(struct wuy_sdict_shard) << bits);
+	assert(sdict->shards != NULL);
+
+	return sdict;
+}
+
+wuy_sdict_t *wuy_sdict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset, int shards)
+{
+	wuy_sdict_t *sdict = wuy_sdict_new(shards);
+	for (int i = 0; i < (1 << sdict->shard_bits); i++) {
+		struct wuy_sdict_shard *shard = &sdict->shards[i];
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->dict = wuy_dict_new_func(key_hash, key_equal, node_offset);
+	}
+	return sdict;
+}
+
+wuy_sdict_t *wuy_sdict_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset, int shards)
+{
+	wuy_sdict_t *sdict = wuy_sdict_new(shards);
+	for (int i = 0; i < (1 << sdict->shard_bits); i++) {
+		struct wuy_sdict_shard *shard = &sdict->shards[i];
+		pthread_mutex_init(&shard->lock, NULL);
+		shard->dict = wuy_dict_new_type(key_type, key_offset, node_offset);
+	}
+	return sdict;
+}
+
+void wuy_sdict_destroy(wuy_sdict_t *sdict)
+{
+	for (int i = 0; i < (1 << sdict->shard_bits); i++) {
+		struct wuy_sdict_shard *shard = &sdict->shards[i];
+		pthread_mutex_destroy(&shard->lock);
+		wuy_dict_destroy(shard->dict);
+	}
+	free(sdict->shards);
+	free(sdict);
+}
+
+void wuy_sdict_enable_hash_cache(wuy_sdict_t *sdict)
+{
+	for (int i = 0; i < (1 << sdict->shard_bits); i++) {
+		wuy_dict_enable_hash_cache(sdict->shards[i].dict);
+	}
+}
+
+/* The low bits of hash value are used to select bucket inside
+ * each dict, so we use the high bits here after mixing. */
+static int wuy_sdict_shard_index(wuy_sdict_t *sdict, uint32_t hash)
+{
+	if (sdict->shard_bits == 0) {
+		return 0;
+	}
+	return (hash * 2654435761u) >> (32 - sdict->shard_bits);
+}
+
+/* all shards have the same key settings, so use the first one to hash */
+static struct wuy_sdict_shard *wuy_sdict_shard_key(wuy_sdict_t *sdict, const void *key)
+{
+	uint32_t hash = _wuy_dict_key_hash(sdict->shards[0].dict, key);
+	return &sdict->shards[wuy_sdict_shard_index(sdict, hash)];
+}
+static struct wuy_sdict_shard *wuy_sdict_shard_item(wuy_sdict_t *sdict, const void *item)
+{
+	uint32_t hash = wuy_dict_item_hash(sdict->shards[0].dict, item);
+	return &sdict->shards[wuy_sdict_shard_index(sdict, hash)];
+}
+
+void wuy_sdict_add(wuy_sdict_t *sdict, void *item)
+{
+	struct wuy_sdict_shard *shard = wuy_sdict_shard_item(sdict, item);
+
+	pthread_mutex_lock(&shard->lock);
+	wuy_dict_add(shard->dict, item);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+/* Lock is needed even for searching, because wuy_dict_get()
+ * may do the incremental expansion. */
+void *_wuy_sdict_get(wuy_sdict_t *sdict, const void *key)
+{
+	struct wuy_sdict_shard *shard = wuy_sdict_shard_key(sdict, key);
+
+	pthread_mutex_lock(&shard->lock);
+	void *item = _wuy_dict_get(shard->dict, key);
+	pthread_mutex_unlock(&shard->lock);
+
+	return item;
+}
+
+void wuy_sdict_delete(wuy_sdict_t *sdict, void *item)
+{
+	struct wuy_sdict_shard *shard = wuy_sdict_shard_item(sdict, item);
+
+	pthread_mutex_lock(&shard->lock);
+	wuy_dict_delete(shard->dict, item);
+	pthread_mutex_unlock(&shard->lock);
+}
+
+void *_wuy_sdict_del_key(wuy_sdict_t *sdict, const void *key)
+{
+	struct wuy_sdict_shard *shard = wuy_sdict_shard_key(sdict, key);
+
+	pthread_mutex_lock(&shard->lock);
+	void *item = _wuy_dict_del_key(shard->dict, key);
+	pthread_mutex_unlock(&shard->lock);
+
+	return item;
+}
+
+size_t wuy_sdict_count(wuy_sdict_t *sdict)
+{
+	size_t count = 0;
+	for (int i = 0; i < (1 << sdict->shard_bits); i++) {
+		struct wuy_sdict_shard *shard = &sdict->shards[i];
+		pthread_mutex_lock(&shard->lock);
+		count += wuy_dict_count(shard->dict);
+		pthread_mutex_unlock(&shard->lock);
+	}
+	return count;
+}
+
+int wuy_sdict_shards(wuy_sdict_t *sdict)
+{
+	return 1 << sdict->shard_bits;
+}
+
+int _wuy_sdict_shard_of(wuy_sdict_t *sdict, const void *key)
+{
+	return wuy_sdict_shard_key(sdict, key) - sdict->shards;
+}
+
+wuy_dict_t *wuy_sdict_shard_lock(wuy_sdict_t *sdict, int shard)
+{
+	pthread_mutex_lock(&sdict->shards[shard].lock);
+	return sdict->shards[shard].dict;
+}
+
+void wuy_sdict_shard_unlock(wuy_sdict_t *sdict, int shard)
+{
+	pthread_mutex_unlock(&sdict->shards[shard].lock);
+}
+
+wuy_dict_t *_wuy_sdict_shard_dict(wuy_sdict_t *sdict, int shard)
+{
+	return sdict->shards[shard].dict;
+}
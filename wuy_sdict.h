@@ -0,0 +1,154 @@
+/**
+ * @file     wuy_sdict.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-22
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * A sharded and thread-safe dictionary, which is a part of libwuya.
+ *
+ * It consists of several wuy_dict, each of which is protected by
+ * its own lock. The shard of an item is selected by the high bits
+ * of its key's hash value. So threads working on different shards
+ * do not contend with each other.
+ *
+ * The usage is same with wuy_dict.
+ */
+
+#ifndef WUY_SDICT_H
+#define WUY_SDICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+
+/**
+ * @brief The sharded dict.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_sdict_s wuy_sdict_t;
+
+/**
+ * @brief Create a sharded dict, with the user-defined key hash/equal function.
+ *
+ * @param shards number of shards, which is aligned up to power of 2.
+ *
+ * Other parameters are same with wuy_dict_new_func().
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_sdict_t *wuy_sdict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset, int shards);
+
+/**
+ * @brief Create a sharded dict, with general key type.
+ *
+ * @param shards number of shards, which is aligned up to power of 2.
+ *
+ * Other parameters are same with wuy_dict_new_type().
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_sdict_t *wuy_sdict_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset, int shards);
+
+/**
+ * @brief Destroy a sharded dict.
+ *
+ * It just frees the dict, but do not releases the nodes.
+ */
+void wuy_sdict_destroy(wuy_sdict_t *sdict);
+
+/**
+ * @brief Call wuy_dict_enable_hash_cache() on all shards.
+ *
+ * @note You MUST NOT call this after adding any node to the dict.
+ */
+void wuy_sdict_enable_hash_cache(wuy_sdict_t *sdict);
+
+/**
+ * @brief Add the item into dict.
+ */
+void wuy_sdict_add(wuy_sdict_t *sdict, void *item);
+
+/**
+ * @brief Search item from dict by the key.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @note The shard is unlocked when this returns, so you must make sure
+ * by yourself that the returned item is not freed by other threads,
+ * e.g. by reference count. Otherwise use wuy_sdict_shard_lock().
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_sdict_get(sdict, key) _wuy_sdict_get(sdict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_sdict_get. You should not use this directly. */
+void *_wuy_sdict_get(wuy_sdict_t *sdict, const void *key);
+
+/**
+ * @brief Delete the item from dict.
+ *
+ * You MUST make sure that item is in this dict.
+ */
+void wuy_sdict_delete(wuy_sdict_t *sdict, void *item);
+
+/**
+ * @brief Delete a key from dict.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_sdict_del_key(sdict, key) _wuy_sdict_del_key(sdict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_sdict_del_key. You should not use this directly. */
+void *_wuy_sdict_del_key(wuy_sdict_t *sdict, const void *key);
+
+/**
+ * @brief Return the count of nodes in all shards.
+ */
+size_t wuy_sdict_count(wuy_sdict_t *sdict);
+
+/**
+ * @brief Return the number of shards.
+ */
+int wuy_sdict_shards(wuy_sdict_t *sdict);
+
+/**
+ * @brief Return the shard index of the key.
+ *
+ * The \b key is same with wuy_dict_get().
+ */
+#define wuy_sdict_shard_of(sdict, key) _wuy_sdict_shard_of(sdict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_sdict_shard_of. You should not use this directly. */
+int _wuy_sdict_shard_of(wuy_sdict_t *sdict, const void *key);
+
+/**
+ * @brief Lock a shard and return its dict.
+ *
+ * Then you can call wuy_dict_xxx() on the returned dict, for
+ * iteration or compound operations, until wuy_sdict_shard_unlock().
+ */
+wuy_dict_t *wuy_sdict_shard_lock(wuy_sdict_t *sdict, int shard);
+
+/**
+ * @brief Unlock a shard.
+ */
+void wuy_sdict_shard_unlock(wuy_sdict_t *sdict, int shard);
+
+/**
+ * @brief Iterate over a shard. The shard MUST be locked.
+ */
+#define wuy_sdict_iter_shard(sdict, shard, p) \
+	wuy_dict_iter(_wuy_sdict_shard_dict(sdict, shard), p)
+
+/* internal. used by wuy_sdict_iter_shard. */
+wuy_dict_t *_wuy_sdict_shard_dict(wuy_sdict_t *sdict, int shard);
+
+#endif
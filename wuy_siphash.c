@@ -0,0 +1,77 @@
+/* SipHash was designed by Jean-Philippe Aumasson and Daniel J. Bernstein.
+ * See https://github.com/veorq/SipHash for the reference implementation.
+ *
+ * We use the SipHash-1-3 variant (1 compression round and 3 finalization
+ * rounds) which is faster and still strong enough for hash tables against
+ * hash-flooding, as used by Rust and Python. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "wuy_siphash.h"
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+	do { \
+		v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+		v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+	} while (0)
+
+static uint64_t u8to64_le(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+uint64_t wuy_siphash(const void *data, size_t len, const uint8_t key[16])
+{
+	const uint8_t *in = data;
+	uint64_t k0 = u8to64_le(key);
+	uint64_t k1 = u8to64_le(key + 8);
+
+	uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+	uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+	uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+	uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+	// body
+	const uint8_t *end = in + len - (len % 8);
+	for (; in != end; in += 8) {
+		uint64_t m = u8to64_le(in);
+		v3 ^= m;
+		SIPROUND;
+		v0 ^= m;
+	}
+
+	// tail
+	uint64_t b = ((uint64_t)len) << 56;
+	switch (len & 7) {
+	case 7: b |= ((uint64_t)in[6]) << 48; /* fall through */
+	case 6: b |= ((uint64_t)in[5]) << 40; /* fall through */
+	case 5: b |= ((uint64_t)in[4]) << 32; /* fall through */
+	case 4: b |= ((uint64_t)in[3]) << 24; /* fall through */
+	case 3: b |= ((uint64_t)in[2]) << 16; /* fall through */
+	case 2: b |= ((uint64_t)in[1]) << 8; /* fall through */
+	case 1: b |= ((uint64_t)in[0]); /* fall through */
+	case 0: break;
+	}
+
+	v3 ^= b;
+	SIPROUND;
+	v0 ^= b;
+
+	// finalization
+	v2 ^= 0xff;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
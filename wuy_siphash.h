@@ -0,0 +1,10 @@
+#ifndef WUY_SIPHASH
+#define WUY_SIPHASH
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* SipHash-1-3 with 128-bit key, 64-bit output. */
+uint64_t wuy_siphash(const void *data, size_t len, const uint8_t key[16]);
+
+#endif
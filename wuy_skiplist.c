@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "wuy_pool.h"
 #include "wuy_skiplist.h"
 
 struct wuy_skiplist_s {
@@ -18,21 +19,58 @@ struct wuy_skiplist_s {
 
 	long			count;
 
+	/* spans of header, after header.nexts[max_level] */
+	bool			rank;
+	long			*header_spans;
+
+	/* towers are allocated from pool, and the freed ones are kept in
+	 * free lists of each level, after header_spans */
+	wuy_pool_t		*tower_pool;
+	wuy_skiplist_node_t	**free_towers;
+
 	wuy_skiplist_node_t	header;
 };
 
+/*
+ * The item node has only level 0. For item with higher level, a tower
+ * node of nexts[level] is allocated, where tower->nexts[0] points to
+ * the item node.
+ *
+ * If rank is enabled, each link at level i (i >= 1) has a span, the
+ * number of items it skips. The spans of a tower are stored before it,
+ * so the span of level i is at ((long *)tower)[-i].
+ *
+ * The towers are allocated from a pool of the skiplist, and the freed
+ * ones are linked by nexts[0] in the free list of their level, to be
+ * reused. So inserting and deleting do not call malloc() and free()
+ * mostly, and the towers are dense in memory.
+ */
+
+#define WUY_SKIPLIST_POOL_BLOCK		(16 * 1024)
 static wuy_skiplist_t *wuy_skiplist_new(size_t node_offset, int max_level)
 {
-	size_t size = sizeof(wuy_skiplist_t) + sizeof(wuy_skiplist_node_t *) * max_level;
+	size_t size = sizeof(wuy_skiplist_t) + sizeof(wuy_skiplist_node_t *) * max_level
+			+ sizeof(long) * max_level
+			+ sizeof(wuy_skiplist_node_t *) * (max_level + 1);
 	wuy_skiplist_t *skiplist = malloc(size);
 	assert(skiplist != NULL);
 
 	bzero(skiplist, size);
 	skiplist->node_offset = node_offset;
 	skiplist->max_level = max_level;
+	skiplist->header_spans = (long *)&skiplist->header.nexts[max_level];
+	skiplist->free_towers = (wuy_skiplist_node_t **)&skiplist->header_spans[max_level];
+	skiplist->tower_pool = wuy_pool_new(WUY_SKIPLIST_POOL_BLOCK);
+	assert(skiplist->tower_pool != NULL);
 	return skiplist;
 }
 
+void wuy_skiplist_destroy(wuy_skiplist_t *skiplist)
+{
+	wuy_pool_destroy(skiplist->tower_pool);
+	free(skiplist);
+}
+
 wuy_skiplist_t *wuy_skiplist_new_func(wuy_skiplist_less_f *key_less,
 		size_t node_offset, int max_level)
 {
@@ -55,6 +93,19 @@ wuy_skiplist_t *wuy_skiplist_new_type(wuy_skiplist_key_type_e key_type,
 	return skiplist;
 }
 
+void wuy_skiplist_enable_rank(wuy_skiplist_t *skiplist)
+{
+	assert(skiplist->count == 0);
+	skiplist->rank = true;
+
+	/* The free towers have no room for spans, so drop them all. */
+	wuy_pool_destroy(skiplist->tower_pool);
+	skiplist->tower_pool = wuy_pool_new(WUY_SKIPLIST_POOL_BLOCK);
+	assert(skiplist->tower_pool != NULL);
+	bzero(skiplist->free_towers, sizeof(wuy_skiplist_node_t *) * (skiplist->max_level + 1));
+	bzero(skiplist->header_spans, sizeof(long) * skiplist->max_level);
+}
+
 static const void *_key_to_item(wuy_skiplist_t *skiplist, const void *key)
 {
 	return (const char *)key - skiplist->key_offset;
@@ -117,27 +168,78 @@ static bool wuy_skiplist_next_less(wuy_skiplist_t *skiplist,
 	return wuy_skiplist_less(skiplist, _node_to_item(skiplist, node->nexts[0]), item);
 }
 
+static long *_span(wuy_skiplist_t *skiplist, wuy_skiplist_node_t *node, int i)
+{
+	if (node == &skiplist->header) {
+		return &skiplist->header_spans[i];
+	}
+	return (long *)node - i;
+}
+
+static wuy_skiplist_node_t *wuy_skiplist_tower_new(wuy_skiplist_t *skiplist, int level)
+{
+	wuy_skiplist_node_t *tower = skiplist->free_towers[level];
+	if (tower != NULL) {
+		skiplist->free_towers[level] = tower->nexts[0];
+		return tower;
+	}
+
+	size_t span_size = skiplist->rank ? sizeof(long) * (level - 1) : 0;
+	char *p = wuy_pool_alloc(skiplist->tower_pool,
+			span_size + sizeof(wuy_skiplist_node_t *) * level);
+	if (p == NULL) {
+		return NULL;
+	}
+	return (wuy_skiplist_node_t *)(p + span_size);
+}
+
+static void wuy_skiplist_tower_free(wuy_skiplist_t *skiplist,
+		wuy_skiplist_node_t *tower, int level)
+{
+	tower->nexts[0] = skiplist->free_towers[level];
+	skiplist->free_towers[level] = tower;
+}
+
+/* Search the previous nodes of key at each level. The number of items
+ * before previous[i] are stored in ranks[i], if ranks is not NULL. */
 static void wuy_skiplist_get_previous(wuy_skiplist_t *skiplist,
-		wuy_skiplist_node_t **previous, const void *key)
+		wuy_skiplist_node_t **previous, const void *key, long *ranks)
 {
 	if (skiplist->level == 0) {
 		previous[0] = NULL;
 		return;
 	}
 
+	long rank = 0;
 	wuy_skiplist_node_t *node = &skiplist->header;
 	for (int i = skiplist->level - 1; i > 0; i--) {
 		while (node->nexts[i] != NULL && wuy_skiplist_next_less(skiplist,
 					node->nexts[i], key)) {
+			if (ranks != NULL) {
+				rank += *_span(skiplist, node, i);
+			}
 			node = node->nexts[i];
 		}
 		previous[i] = node;
+		if (ranks != NULL) {
+			ranks[i] = rank;
+		}
+	}
+
+	/* node is a tower now, whose item is less than key and has been
+	 * counted in rank. Move to the item node at the same position. */
+	if (node != &skiplist->header) {
+		node = node->nexts[0];
 	}
 
 	while (node->nexts[0] != NULL && wuy_skiplist_next_less(skiplist, node, key)) {
+		rank++;
 		node = node->nexts[0];
 	}
 	previous[0] = node;
+	if (ranks != NULL) {
+		ranks[0] = rank;
+	}
 }
 
 static int wuy_skiplist_random_level(int max)
@@ -161,13 +263,27 @@ static int wuy_skiplist_random_level(int max)
 bool wuy_skiplist_insert(wuy_skiplist_t *skiplist, void *item)
 {
 	wuy_skiplist_node_t *previous[skiplist->max_level];
-	wuy_skiplist_get_previous(skiplist, previous, item);
+	long ranks[skiplist->max_level];
+	wuy_skiplist_get_previous(skiplist, previous, item,
+			skiplist->rank ? ranks : NULL);
 
 	int level = wuy_skiplist_random_level(skiplist->max_level);
 
+	/* allocate before linking anything, so nothing changes if fails */
+	wuy_skiplist_node_t *new_node = NULL;
+	if (level > 1) {
+		new_node = wuy_skiplist_tower_new(skiplist, level);
+		if (new_node == NULL) {
+			return false;
+		}
+	}
+
 	/* increase skiplist->level if need */
 	while (skiplist->level < level) {
-		previous[skiplist->level++] = &skiplist->header;
+		previous[skiplist->level] = &skiplist->header;
+		ranks[skiplist->level] = 0;
+		skiplist->header_spans[skiplist->level] = skiplist->count;
+		skiplist->level++;
 	}
 
 	wuy_skiplist_node_t *item_node = _item_to_node(skiplist, item);
@@ -175,17 +291,26 @@ bool wuy_skiplist_insert(wuy_skiplist_t *skiplist, void *item)
 	previous[0]->nexts[0] = item_node;
 
 	if (level > 1) {
-		wuy_skiplist_node_t *new_node = malloc(sizeof(wuy_skiplist_node_t *) * level);
-		if (new_node == NULL) {
-			return false;
-		}
 		for (int i = level - 1; i > 0; i--) {
 			new_node->nexts[i] = previous[i]->nexts[i];
 			previous[i]->nexts[i] = new_node;
+
+			if (skiplist->rank) {
+				long *prev_span = _span(skiplist, previous[i], i);
+				*_span(skiplist, new_node, i) = *prev_span - (ranks[0] - ranks[i]);
+				*prev_span = ranks[0] - ranks[i] + 1;
+			}
 		}
 		new_node->nexts[0] = item_node;
 	}
 
+	/* the links above the new node skip one more item */
+	if (skiplist->rank) {
+		for (int i = level; i < skiplist->level; i++) {
+			(*_span(skiplist, previous[i], i))++;
+		}
+	}
+
 	skiplist->count++;
 
 	return true;
@@ -202,12 +327,25 @@ static void wuy_skiplist_delete_node(wuy_skiplist_t *skiplist,
 		}
 	}
 	wuy_skiplist_node_t *ex_node = previous[i]->nexts[i];
+
+	if (skiplist->rank) {
+		for (int j = 1; j < skiplist->level; j++) {
+			long *prev_span = _span(skiplist, previous[j], j);
+			if (j <= i) {
+				*prev_span += *_span(skiplist, ex_node, j) - 1;
+			} else {
+				(*prev_span)--;
+			}
+		}
+	}
+
+	int level = i + 1;
 	for (; i >= 0; i--) {
 		previous[i]->nexts[i] = previous[i]->nexts[i]->nexts[i];
 	}
 
 	if (ex_node != node) {
-		free(ex_node);
+		wuy_skiplist_tower_free(skiplist, ex_node, level);
 	}
 
 	/* decrease skiplist->level if need */
@@ -225,7 +363,7 @@ bool wuy_skiplist_delete(wuy_skiplist_t *skiplist, void *item)
 	}
 
 	wuy_skiplist_node_t *previous[skiplist->max_level];
-	wuy_skiplist_get_previous(skiplist, previous, item);
+	wuy_skiplist_get_previous(skiplist, previous, item, NULL);
 
 	wuy_skiplist_node_t *node = _item_to_node(skiplist, item);
 	if (previous[0]->nexts[0] != node) {
@@ -248,9 +386,15 @@ static void *wuy_skiplist_search_key(wuy_skiplist_t *skiplist,
 		key_item = _key_to_item(skiplist, &key);
 	}
 
-	wuy_skiplist_get_previous(skiplist, previous, key_item);
+	wuy_skiplist_get_previous(skiplist, previous, key_item, NULL);
+
+	/* all items are less than key */
+	wuy_skiplist_node_t *next = previous[0]->nexts[0];
+	if (next == NULL) {
+		return NULL;
+	}
 
-	void *item = _node_to_item(skiplist, previous[0]->nexts[0]);
+	void *item = _node_to_item(skiplist, next);
 	if (wuy_skiplist_less(skiplist, key_item, item)) {
 		return NULL;
 	}
@@ -281,6 +425,23 @@ wuy_skiplist_node_t *wuy_skiplist_iter_new(wuy_skiplist_t *skiplist)
 	return skiplist->header.nexts[0];
 }
 
+wuy_skiplist_node_t *_wuy_skiplist_seek(wuy_skiplist_t *skiplist, const void *key)
+{
+	if (skiplist->level == 0) {
+		return NULL;
+	}
+
+	const void *key_item = key;
+	if (skiplist->key_less == NULL) {
+		key_item = _key_to_item(skiplist, &key);
+	}
+
+	/* the next of previous[0] is the first item not less than key */
+	wuy_skiplist_node_t *previous[skiplist->max_level];
+	wuy_skiplist_get_previous(skiplist, previous, key_item, NULL);
+	return previous[0]->nexts[0];
+}
+
 void *wuy_skiplist_iter_next(wuy_skiplist_t *skiplist, wuy_skiplist_node_t **iter)
 {
 	wuy_skiplist_node_t *next = *iter;
@@ -307,6 +468,63 @@ void *wuy_skiplist_first(wuy_skiplist_t *skiplist)
 	return node != NULL ? _node_to_item(skiplist, node) : NULL;
 }
 
+long wuy_skiplist_rank(wuy_skiplist_t *skiplist, const void *item)
+{
+	assert(skiplist->rank);
+
+	if (skiplist->level == 0) {
+		return -1;
+	}
+
+	wuy_skiplist_node_t *previous[skiplist->max_level];
+	long ranks[skiplist->max_level];
+	wuy_skiplist_get_previous(skiplist, previous, item, ranks);
+
+	if (previous[0]->nexts[0] != _item_to_node(skiplist, item)) {
+		return -1;
+	}
+	return ranks[0];
+}
+
+wuy_skiplist_node_t *_wuy_skiplist_iter_at(wuy_skiplist_t *skiplist, long rank)
+{
+	assert(skiplist->rank);
+
+	if (rank < 0 || rank >= skiplist->count) {
+		return NULL;
+	}
+
+	/* the target's position, counting from 1 */
+	long target = rank + 1;
+	long pos = 0;
+
+	wuy_skiplist_node_t *node = &skiplist->header;
+	for (int i = skiplist->level - 1; i > 0; i--) {
+		while (node->nexts[i] != NULL && pos + *_span(skiplist, node, i) <= target) {
+			pos += *_span(skiplist, node, i);
+			node = node->nexts[i];
+		}
+		if (pos == target) {
+			return node->nexts[0]; /* item node of the tower */
+		}
+	}
+
+	if (node != &skiplist->header) {
+		node = node->nexts[0];
+	}
+	while (pos < target) {
+		node = node->nexts[0];
+		pos++;
+	}
+	return node;
+}
+
+void *wuy_skiplist_at(wuy_skiplist_t *skiplist, long rank)
+{
+	wuy_skiplist_node_t *node = _wuy_skiplist_iter_at(skiplist, rank);
+	return node != NULL ? _node_to_item(skiplist, node) : NULL;
+}
+
 long wuy_skiplist_count(wuy_skiplist_t *skiplist)
 {
 	return skiplist->count;
@@ -9,6 +9,10 @@
  * @section DESCRIPTION
  *
  * A skip list.
+ *
+ * Call wuy_skiplist_enable_rank() to maintain the span of each link,
+ * i.e. the number of items it skips. Then wuy_skiplist_rank() and
+ * wuy_skiplist_at() work in O(log(n)), as in the sorted-set servers.
  */
 
 #ifndef WUY_SKIPLIST_H
@@ -89,6 +93,20 @@ wuy_skiplist_t *wuy_skiplist_new_type(wuy_skiplist_key_type_e key_type,
 		size_t key_offset, bool key_reverse,
 		size_t node_offset, int max_level);
 
+/**
+ * @brief Destroy the skiplist. The items are not released.
+ */
+void wuy_skiplist_destroy(wuy_skiplist_t *skiplist);
+
+/**
+ * @brief Maintain the spans for wuy_skiplist_rank() and wuy_skiplist_at().
+ *
+ * This costs some memory and time for inserting and deleting.
+ *
+ * @note You MUST NOT call this after inserting any item.
+ */
+void wuy_skiplist_enable_rank(wuy_skiplist_t *skiplist);
+
 /**
  * @brief Insert an item to skiplist.
  *
@@ -136,6 +154,66 @@ bool wuy_skiplist_iter_less(wuy_skiplist_t *skiplist,
 		(item = wuy_skiplist_iter_next(skiplist, &_sk_iter)) != NULL \
 			&& (stop == NULL || wuy_skiplist_iter_less(skiplist, item, stop)); )
 
+/**
+ * @brief Return an iterator at the first item not less than the key,
+ * in O(log(n)).
+ *
+ * The \b key is same with wuy_skiplist_search().
+ * Use it with wuy_skiplist_iter_next().
+ */
+#define wuy_skiplist_seek(skiplist, key) \
+	_wuy_skiplist_seek(skiplist, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_skiplist_seek. You should not use this directly. */
+wuy_skiplist_node_t *_wuy_skiplist_seek(wuy_skiplist_t *skiplist, const void *key);
+
+/**
+ * @brief Iterate over the items not less than \b lo.
+ */
+#define wuy_skiplist_iter_from(skiplist, item, lo) \
+	for (wuy_skiplist_node_t *_sk_iter = wuy_skiplist_seek(skiplist, lo); \
+		(item = wuy_skiplist_iter_next(skiplist, &_sk_iter)) != NULL; )
+
+/**
+ * @brief Iterate over the items in range [\b lo, \b hi).
+ */
+#define wuy_skiplist_iter_range(skiplist, item, lo, hi) \
+	for (wuy_skiplist_node_t *_sk_iter = wuy_skiplist_seek(skiplist, lo); \
+		(item = wuy_skiplist_iter_next(skiplist, &_sk_iter)) != NULL \
+			&& wuy_skiplist_iter_less(skiplist, item, (const void *)(uintptr_t)(hi)); )
+
+/**
+ * @brief Return the rank of the item, i.e. the number of items before it.
+ *
+ * It works only if wuy_skiplist_enable_rank() is called.
+ *
+ * @return the rank counting from 0, or -1 if the item is not linked.
+ */
+long wuy_skiplist_rank(wuy_skiplist_t *skiplist, const void *item);
+
+/**
+ * @brief Return the item of the rank, counting from 0.
+ *
+ * It works only if wuy_skiplist_enable_rank() is called.
+ *
+ * @return the item, or NULL if rank is out of range.
+ */
+void *wuy_skiplist_at(wuy_skiplist_t *skiplist, long rank);
+
+/* Used by macro wuy_skiplist_iter_rank. You should not use this directly. */
+wuy_skiplist_node_t *_wuy_skiplist_iter_at(wuy_skiplist_t *skiplist, long rank);
+
+/**
+ * @brief Iterate over the items with rank in [\b start, \b stop).
+ *
+ * It works only if wuy_skiplist_enable_rank() is called.
+ */
+#define wuy_skiplist_iter_rank(skiplist, item, start, stop) \
+	for (long _sk_rank = (start), _sk_once = 1; _sk_once; _sk_once = 0) \
+		for (wuy_skiplist_node_t *_sk_iter = _wuy_skiplist_iter_at(skiplist, _sk_rank); \
+			_sk_rank < (stop) && (item = wuy_skiplist_iter_next(skiplist, &_sk_iter)) != NULL; \
+			_sk_rank++)
+
 /**
  * @brief Return the first item.
  */
@@ -0,0 +1,258 @@
+/**
+ * @file     wuy_tdict.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-25
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * Type-specialized dictionary, generated by macro. Header only.
+ *
+ * wuy_dict decides how to hash and compare keys at runtime, by switch
+ * on key type or by calling the hash/equal functions. This one
+ * generates the dict functions for your data struct at compile time,
+ * so the hash and equal are inlined, and the key is passed by value
+ * with its own type.
+ *
+ * The buckets expand and shrink incrementally as wuy_dict.
+ *
+ * Example:
+ *
+ *   struct user {
+ *       uint64_t          id;
+ *       wuy_dict_node_t   node;
+ *   };
+ *   WUY_DICT_DEFINE(user_dict, struct user, id, node,
+ *           wuy_tdict_hash_uint, wuy_tdict_equal_value)
+ *
+ *   user_dict_t *dict = user_dict_new();
+ *   user_dict_add(dict, user);
+ *   struct user *u = user_dict_get(dict, 123);
+ *
+ * The generated functions with the prefix NAME are:
+ *
+ *   NAME_t *NAME_new(void);
+ *   void NAME_destroy(NAME_t *dict);
+ *   void NAME_add(NAME_t *dict, TYPE *item);
+ *   TYPE *NAME_get(NAME_t *dict, KEY key);
+ *   void NAME_delete(NAME_t *dict, TYPE *item);
+ *   TYPE *NAME_del_key(NAME_t *dict, KEY key);
+ *   size_t NAME_count(NAME_t *dict);
+ *
+ * where KEY is the type of the key member, which must be passed by
+ * value, e.g. integers or `const char *`, but not char array.
+ *
+ * Use wuy_tdict_iter() to iterate.
+ */
+
+#ifndef WUY_TDICT_H
+#define WUY_TDICT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wuy_dict.h"
+#include "wuy_container.h"
+
+#define WUY_TDICT_SIZE_INIT		64
+#define WUY_TDICT_SIZE_MAX		(64*1024*1024)
+#define WUY_TDICT_EXPANSION_FACTOR	2
+#define WUY_TDICT_SHRINK_FACTOR		4
+
+/**
+ * @brief Hash an integer key.
+ */
+#define wuy_tdict_hash_uint(k)	((uint32_t)((uint64_t)(k) ^ ((uint64_t)(k) >> 32)))
+
+/**
+ * @brief Compare integer or pointer keys.
+ */
+#define wuy_tdict_equal_value(a, b)	((a) == (b))
+
+/**
+ * @brief Compare string keys.
+ */
+#define wuy_tdict_equal_string(a, b)	(strcmp(a, b) == 0)
+
+/**
+ * @brief Define a dict type and its functions.
+ *
+ * @param name the prefix of generated type and functions;
+ * @param type your data struct type;
+ * @param key_member the key member in your data struct;
+ * @param node_member the wuy_dict_node_t member in your data struct;
+ * @param hash function or macro, `uint32_t hash(KEY key)`;
+ * @param equal function or macro, `bool equal(KEY item_key, KEY key)`.
+ */
+#define WUY_DICT_DEFINE(name, type, key_member, node_member, hash, equal) \
+\
+typedef __typeof__(((type *)0)->key_member) name##_key_t; \
+\
+typedef struct { \
+	wuy_hlist_t	*buckets; \
+	wuy_hlist_t	*prev_buckets; \
+	uint32_t	bucket_size; \
+	uint32_t	prev_size; \
+	uint32_t	split; \
+	size_t		count; \
+} name##_t; \
+\
+static inline type *name##_node_item(wuy_hlist_node_t *node) \
+{ \
+	return wuy_containerof(node, type, node_member); \
+} \
+\
+static inline name##_t *name##_new(void) \
+{ \
+	name##_t *dict = malloc(sizeof(name##_t)); \
+	assert(dict != NULL); \
+	dict->bucket_size = WUY_TDICT_SIZE_INIT; \
+	dict->buckets = calloc(dict->bucket_size, sizeof(wuy_hlist_t)); \
+	assert(dict->buckets != NULL); \
+	dict->prev_buckets = NULL; \
+	dict->prev_size = 0; \
+	dict->split = 0; \
+	dict->count = 0; \
+	return dict; \
+} \
+\
+static inline void name##_destroy(name##_t *dict) \
+{ \
+	free(dict->buckets); \
+	free(dict->prev_buckets); \
+	free(dict); \
+} \
+\
+static inline void name##_resize(name##_t *dict, uint32_t new_size) \
+{ \
+	wuy_hlist_t *newb = calloc(new_size, sizeof(wuy_hlist_t)); \
+	if (newb == NULL) { \
+		return; \
+	} \
+	dict->prev_buckets = dict->buckets; \
+	dict->prev_size = dict->bucket_size; \
+	dict->buckets = newb; \
+	dict->bucket_size = new_size; \
+	dict->split = 0; \
+} \
+\
+static inline void name##_expasion(name##_t *dict) \
+{ \
+	if (dict->prev_buckets == NULL) { \
+		if (dict->count >= (size_t)dict->bucket_size * WUY_TDICT_EXPANSION_FACTOR \
+				&& dict->bucket_size < WUY_TDICT_SIZE_MAX) { \
+			name##_resize(dict, dict->bucket_size * 2); \
+		} else if (dict->count < dict->bucket_size / WUY_TDICT_SHRINK_FACTOR \
+				&& dict->bucket_size > WUY_TDICT_SIZE_INIT) { \
+			name##_resize(dict, dict->bucket_size / 2); \
+		} \
+		if (dict->prev_buckets == NULL) { \
+			return; \
+		} \
+	} \
+\
+	wuy_hlist_node_t *node, *safe; \
+	wuy_hlist_iter_safe(&dict->prev_buckets[dict->split], node, safe) { \
+		uint32_t h = hash(name##_node_item(node)->key_member); \
+		wuy_hlist_insert(&dict->buckets[h & (dict->bucket_size - 1)], node); \
+	} \
+	wuy_hlist_init(&dict->prev_buckets[dict->split]); \
+	dict->split++; \
+	if (dict->split == dict->prev_size) { \
+		free(dict->prev_buckets); \
+		dict->prev_buckets = NULL; \
+		dict->prev_size = 0; \
+	} \
+} \
+\
+static inline void name##_add(name##_t *dict, type *item) \
+{ \
+	uint32_t h = hash(item->key_member); \
+	wuy_hlist_insert(&dict->buckets[h & (dict->bucket_size - 1)], \
+			&item->node_member); \
+	dict->count++; \
+	name##_expasion(dict); \
+} \
+\
+static inline type *name##_search_bucket(wuy_hlist_t *bucket, name##_key_t key) \
+{ \
+	wuy_hlist_node_t *node; \
+	wuy_hlist_iter(bucket, node) { \
+		type *item = name##_node_item(node); \
+		if (equal(item->key_member, key)) { \
+			return item; \
+		} \
+	} \
+	return NULL; \
+} \
+\
+static inline type *name##_get(name##_t *dict, name##_key_t key) \
+{ \
+	name##_expasion(dict); \
+\
+	uint32_t h = hash(key); \
+	type *item = name##_search_bucket(&dict->buckets[h & (dict->bucket_size - 1)], key); \
+	if (item == NULL && dict->prev_buckets != NULL) { \
+		item = name##_search_bucket(&dict->prev_buckets[h & (dict->prev_size - 1)], key); \
+	} \
+	return item; \
+} \
+\
+static inline void name##_delete(name##_t *dict, type *item) \
+{ \
+	wuy_hlist_delete(&item->node_member); \
+	dict->count--; \
+} \
+\
+static inline type *name##_del_key(name##_t *dict, name##_key_t key) \
+{ \
+	type *item = name##_get(dict, key); \
+	if (item != NULL) { \
+		name##_delete(dict, item); \
+	} \
+	return item; \
+} \
+\
+static inline size_t name##_count(name##_t *dict) \
+{ \
+	return dict->count; \
+} \
+\
+static inline bool name##_iter_buckets(name##_t *dict, wuy_hlist_t **start, \
+		wuy_hlist_t **end) \
+{ \
+	if (*start == NULL) { \
+		*start = dict->buckets; \
+		*end = dict->buckets + dict->bucket_size; \
+		return true; \
+	} \
+	if (dict->prev_buckets != NULL && *start == dict->buckets) { \
+		*start = dict->prev_buckets + dict->split; \
+		*end = dict->prev_buckets + dict->prev_size; \
+		return true; \
+	} \
+	return false; \
+}
+
+/**
+ * @brief Iterate over a dict defined by WUY_DICT_DEFINE().
+ *
+ * @param p a pointer of your data struct type.
+ *
+ * It's safe to delete item during it.
+ */
+#define wuy_tdict_iter(name, dict, p) \
+	for (wuy_hlist_t *_ibck_start = NULL, *_ibck_end = NULL; \
+		name##_iter_buckets(dict, &_ibck_start, &_ibck_end); ) \
+		for (wuy_hlist_t *_ib = _ibck_start; _ib < _ibck_end; _ib++) \
+			for (wuy_hlist_node_t *_next, *_iter = _ib->first; \
+				_iter != NULL && (_next = _iter->next, \
+					p = name##_node_item(_iter)); \
+				_iter = _next)
+
+#endif
@@ -22,4 +22,14 @@ static inline long wuy_time_ms(void)
 	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
+/* Monotonic time, which is not affected by the wall clock changes.
+ * Use it for timeouts and intervals, but not for timestamps. */
+#include <time.h>
+static inline long wuy_time_mono_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 #endif
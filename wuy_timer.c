@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "wuy_time.h"
+#include "wuy_timer.h"
+
+/*
+ * Level L covers the timers expiring in [64^L, 64^(L+1)) ticks from
+ * current, and the slot is the L-th 6-bit digit of the expire tick.
+ * When current enters a new block of 64^L ticks, the timers in the
+ * slot of this block at level L are moved into lower levels, which
+ * is called cascading.
+ *
+ * current is the next tick to be processed. All ticks before it
+ * have been processed.
+ *
+ * Each level has a bitmap of non-empty slots, for wuy_timer_next().
+ */
+#define WUY_TIMER_BITS		6
+#define WUY_TIMER_SLOTS		(1 << WUY_TIMER_BITS)
+#define WUY_TIMER_MASK		(WUY_TIMER_SLOTS - 1)
+#define WUY_TIMER_LEVELS	5
+#define WUY_TIMER_MAX_DELTA	((1L << (WUY_TIMER_BITS * WUY_TIMER_LEVELS)) - 1)
+
+struct wuy_timer_s {
+	long			tick;
+	long			current;
+	size_t			count;
+	size_t			node_offset;
+	wuy_timer_handler_f	*handler;
+
+	uint64_t		bitmaps[WUY_TIMER_LEVELS];
+	wuy_list_t		wheel[WUY_TIMER_LEVELS * WUY_TIMER_SLOTS];
+};
+
+wuy_timer_t *wuy_timer_new(long tick, wuy_timer_handler_f *handler, size_t node_offset)
+{
+	assert(tick > 0);
+
+	wuy_timer_t *timer = malloc(sizeof(wuy_timer_t));
+	assert(timer != NULL);
+
+	timer->tick = tick;
+	timer->current = wuy_time_mono_ms() / tick;
+	timer->count = 0;
+	timer->node_offset = node_offset;
+	timer->handler = handler;
+
+	for (int i = 0; i < WUY_TIMER_LEVELS; i++) {
+		timer->bitmaps[i] = 0;
+	}
+	for (int i = 0; i < WUY_TIMER_LEVELS * WUY_TIMER_SLOTS; i++) {
+		wuy_list_init(&timer->wheel[i]);
+	}
+	return timer;
+}
+
+void wuy_timer_destroy(wuy_timer_t *timer)
+{
+	free(timer);
+}
+
+static wuy_timer_node_t *_item_to_node(wuy_timer_t *timer, const void *item)
+{
+	return (wuy_timer_node_t *)((char *)item + timer->node_offset);
+}
+static void *_node_to_item(wuy_timer_t *timer, wuy_timer_node_t *node)
+{
+	return (char *)node - timer->node_offset;
+}
+
+static void wuy_timer_link(wuy_timer_t *timer, wuy_timer_node_t *node)
+{
+	long expire = node->expire;
+	if (expire < timer->current) {
+		expire = timer->current;
+	}
+
+	long delta = expire - timer->current;
+	if (delta > WUY_TIMER_MAX_DELTA) {
+		/* moved again when cascading */
+		expire = timer->current + WUY_TIMER_MAX_DELTA;
+		delta = WUY_TIMER_MAX_DELTA;
+	}
+
+	int level = 0;
+	while (delta >= WUY_TIMER_SLOTS) {
+		delta >>= WUY_TIMER_BITS;
+		level++;
+	}
+
+	int index = (expire >> (WUY_TIMER_BITS * level)) & WUY_TIMER_MASK;
+	node->slot = level * WUY_TIMER_SLOTS + index;
+	wuy_list_append(&timer->wheel[node->slot], &node->list_node);
+	timer->bitmaps[level] |= 1ULL << index;
+}
+
+static void wuy_timer_unlink(wuy_timer_t *timer, wuy_timer_node_t *node)
+{
+	wuy_list_delete(&node->list_node);
+
+	if (wuy_list_empty(&timer->wheel[node->slot])) {
+		int level = node->slot / WUY_TIMER_SLOTS;
+		int index = node->slot % WUY_TIMER_SLOTS;
+		timer->bitmaps[level] &= ~(1ULL << index);
+	}
+}
+
+void wuy_timer_add(wuy_timer_t *timer, void *item, long timeout)
+{
+	wuy_timer_node_t *node = _item_to_node(timer, item);
+
+	if (wuy_list_node_linked(&node->list_node)) {
+		wuy_timer_unlink(timer, node);
+	} else {
+		timer->count++;
+	}
+
+	/* round up, so it does not fire early */
+	node->expire = (wuy_time_mono_ms() + timeout + timer->tick - 1) / timer->tick;
+	wuy_timer_link(timer, node);
+}
+
+bool wuy_timer_delete(wuy_timer_t *timer, void *item)
+{
+	wuy_timer_node_t *node = _item_to_node(timer, item);
+	if (!wuy_list_node_linked(&node->list_node)) {
+		return false;
+	}
+	wuy_timer_unlink(timer, node);
+	timer->count--;
+	return true;
+}
+
+bool wuy_timer_pending(wuy_timer_t *timer, void *item)
+{
+	return wuy_list_node_linked(&_item_to_node(timer, item)->list_node);
+}
+
+/* move all timers in the slot into a temporary list */
+static void wuy_timer_take_slot(wuy_timer_t *timer, int level, int index, wuy_list_t *out)
+{
+	wuy_list_t *slot = &timer->wheel[level * WUY_TIMER_SLOTS + index];
+	wuy_list_node_t *lnode;
+	while ((lnode = wuy_list_pop(slot)) != NULL) {
+		wuy_list_append(out, lnode);
+	}
+	timer->bitmaps[level] &= ~(1ULL << index);
+}
+
+static void wuy_timer_cascade(wuy_timer_t *timer)
+{
+	for (int level = 1; level < WUY_TIMER_LEVELS; level++) {
+		int shift = WUY_TIMER_BITS * level;
+		if ((timer->current & ((1L << shift) - 1)) != 0) {
+			break;
+		}
+
+		int index = (timer->current >> shift) & WUY_TIMER_MASK;
+		if (timer->bitmaps[level] & (1ULL << index)) {
+			wuy_list_t tmp;
+			wuy_list_init(&tmp);
+			wuy_timer_take_slot(timer, level, index, &tmp);
+
+			wuy_timer_node_t *node;
+			while (wuy_list_pop_type(&tmp, node, list_node) != NULL) {
+				wuy_timer_link(timer, node);
+			}
+		}
+	}
+}
+
+/* Return the nearest tick when something need to be done, firing
+ * at level 0 or cascading at higher levels. */
+static long wuy_timer_next_tick(wuy_timer_t *timer)
+{
+	long next = -1;
+	for (int level = 0; level < WUY_TIMER_LEVELS; level++) {
+		uint64_t bitmap = timer->bitmaps[level];
+		if (bitmap == 0) {
+			continue;
+		}
+
+		int shift = WUY_TIMER_BITS * level;
+		long block = timer->current >> shift;
+		int pos = block & WUY_TIMER_MASK;
+
+		/* rotate so that bit 0 is the slot of current block */
+		uint64_t rotated = pos == 0 ? bitmap : (bitmap >> pos) | (bitmap << (64 - pos));
+		long k = __builtin_ctzll(rotated);
+
+		/* the current block at higher level has been cascaded
+		 * already, unless current is at its beginning */
+		if (k == 0 && level > 0 && (timer->current & ((1L << shift) - 1)) != 0) {
+			rotated &= ~1ULL;
+			k = rotated != 0 ? __builtin_ctzll(rotated) : WUY_TIMER_SLOTS;
+		}
+
+		long tick = level == 0 ? timer->current + k : (block + k) << shift;
+		if (next < 0 || tick < next) {
+			next = tick;
+		}
+	}
+	return next;
+}
+
+int wuy_timer_expire(wuy_timer_t *timer)
+{
+	long now_tick = wuy_time_mono_ms() / timer->tick;
+
+	int count = 0;
+	while (timer->current <= now_tick) {
+		/* skip the ticks with nothing to do */
+		long next = wuy_timer_next_tick(timer);
+		if (next < 0 || next > now_tick) {
+			timer->current = now_tick + 1;
+			break;
+		}
+		timer->current = next;
+
+		wuy_timer_cascade(timer);
+
+		/* Take the timers out before firing, and move forward
+		 * current, so the handlers can add timers safely. */
+		long tick = timer->current;
+		wuy_list_t tmp;
+		wuy_list_init(&tmp);
+		wuy_timer_take_slot(timer, 0, tick & WUY_TIMER_MASK, &tmp);
+		timer->current++;
+
+		wuy_timer_node_t *node;
+		while (wuy_list_pop_type(&tmp, node, list_node) != NULL) {
+			if (node->expire > tick) { /* too far when added */
+				wuy_timer_link(timer, node);
+				continue;
+			}
+			timer->count--;
+			timer->handler(_node_to_item(timer, node));
+			count++;
+		}
+	}
+	return count;
+}
+
+long wuy_timer_next(wuy_timer_t *timer)
+{
+	long next = wuy_timer_next_tick(timer);
+	if (next < 0) {
+		return -1;
+	}
+
+	long ms = next * timer->tick - wuy_time_mono_ms();
+	return ms > 0 ? ms : 0;
+}
+
+size_t wuy_timer_count(wuy_timer_t *timer)
+{
+	return timer->count;
+}
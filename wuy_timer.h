@@ -0,0 +1,133 @@
+/**
+ * @file     wuy_timer.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-8-2
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * Hierarchical timing wheel, for timeouts which are rescheduled or
+ * cancelled much more frequently than fired, e.g. connection timeouts.
+ *
+ * Adding, rescheduling and cancelling are all O(1), compared to
+ * O(log(n)) of wuy_heap. The cost is that a timer may be moved into
+ * lower levels a few times before firing.
+ *
+ * There are 5 levels of 64 slots. Timers further than 64^5 ticks
+ * are put into the last level and moved again later.
+ *
+ * Example of working with wuy_event:
+ *
+ *   while (1) {
+ *       wuy_event_run(ctx, wuy_timer_next(timer));
+ *       wuy_timer_expire(timer);
+ *   }
+ */
+
+#ifndef WUY_TIMER_H
+#define WUY_TIMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "wuy_list.h"
+
+/**
+ * @brief The timer wheel.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_timer_s wuy_timer_t;
+
+/**
+ * @brief Embed this node into your data struct in order to use this lib.
+ *
+ * You MUST initialize it by wuy_timer_node_init() or zero before used,
+ * and need not touch it later.
+ */
+typedef struct {
+	wuy_list_node_t	list_node;
+	long		expire; /* in ticks */
+	int		slot;
+} wuy_timer_node_t;
+
+/**
+ * @brief Called when a timer fires.
+ *
+ * The timer has been removed when the handler is called, so you can
+ * add it again in the handler.
+ */
+typedef void wuy_timer_handler_f(void *item);
+
+/**
+ * @brief Create a timer wheel.
+ *
+ * @param tick the milliseconds of each tick, which is the precision.
+ * @param handler called when a timer fires.
+ * @param node_offset the offset of wuy_timer_node_t in your data struct.
+ *
+ * @return the new timer wheel. It aborts the program if memory allocation fails.
+ */
+wuy_timer_t *wuy_timer_new(long tick, wuy_timer_handler_f *handler, size_t node_offset);
+
+/**
+ * @brief Destroy the timer wheel. The pending timers are not fired.
+ */
+void wuy_timer_destroy(wuy_timer_t *timer);
+
+/**
+ * @brief Initialize the node.
+ */
+static inline void wuy_timer_node_init(wuy_timer_node_t *node)
+{
+	node->list_node.next = node->list_node.prev = NULL;
+}
+
+/**
+ * @brief Add the item to fire after timeout milliseconds.
+ *
+ * If the item is pending already, it is rescheduled.
+ *
+ * The timer does not fire earlier than timeout, but may fire later
+ * at most one tick. The monotonic clock is used, so changing the
+ * wall clock does not affect it.
+ */
+void wuy_timer_add(wuy_timer_t *timer, void *item, long timeout);
+
+/**
+ * @brief Cancel the item.
+ *
+ * @return true if it was pending, or false if not.
+ */
+bool wuy_timer_delete(wuy_timer_t *timer, void *item);
+
+/**
+ * @brief Return if the item is pending.
+ */
+bool wuy_timer_pending(wuy_timer_t *timer, void *item);
+
+/**
+ * @brief Fire the expired timers.
+ *
+ * @return the number of fired timers.
+ */
+int wuy_timer_expire(wuy_timer_t *timer);
+
+/**
+ * @brief Return the milliseconds until the next time to call
+ * wuy_timer_expire(), or -1 if no pending timers.
+ *
+ * This is suitable for the timeout of wuy_event_run(). It may be
+ * earlier than the nearest timer if some timers need to be moved
+ * between levels, and then wuy_timer_expire() fires nothing.
+ */
+long wuy_timer_next(wuy_timer_t *timer);
+
+/**
+ * @brief Return the count of pending timers.
+ */
+size_t wuy_timer_count(wuy_timer_t *timer);
+
+#endif
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "wuy_time.h"
+#include "wuy_ttldict.h"
+
+/*
+ * Each item is in the wheel slot of its expire tick, where the tick
+ * is the expire time divided by resolution. The items in one slot may
+ * be in different rounds, so the expire time is checked when reaping.
+ *
+ * The expire time is in the monotonic clock, so changing the wall
+ * clock does not expire the items earlier or later.
+ *
+ * reap_tick is the slot being reaped. It only moves forward. Items
+ * expiring before reap_tick are put into the slot of reap_tick.
+ */
+struct wuy_ttldict_s {
+	wuy_dict_t		*dict;
+	size_t			node_offset;
+
+	wuy_list_t		*wheel;
+	int			slots;
+	long			resolution;
+	long			reap_tick;
+
+	wuy_ttldict_expire_f	*expire_handler;
+};
+
+#define WUY_TTLDICT_SLOTS_DEFAULT	4096
+#define WUY_TTLDICT_RESOLUTION_DEFAULT	100
+
+static wuy_list_t *wuy_ttldict_wheel_new(int slots)
+{
+	wuy_list_t *wheel = malloc(sizeof(wuy_list_t) * slots);
+	assert(wheel != NULL);
+	for (int i = 0; i < slots; i++) {
+		wuy_list_init(&wheel[i]);
+	}
+	return wheel;
+}
+
+static wuy_ttldict_t *wuy_ttldict_new(wuy_dict_t *dict, size_t node_offset)
+{
+	wuy_ttldict_t *ttldict = malloc(sizeof(wuy_ttldict_t));
+	assert(ttldict != NULL);
+
+	ttldict->dict = dict;
+	ttldict->node_offset = node_offset;
+	ttldict->slots = WUY_TTLDICT_SLOTS_DEFAULT;
+	ttldict->resolution = WUY_TTLDICT_RESOLUTION_DEFAULT;
+	ttldict->wheel = wuy_ttldict_wheel_new(ttldict->slots);
+	ttldict->reap_tick = wuy_time_mono_ms() / ttldict->resolution;
+	ttldict->expire_handler = NULL;
+	return ttldict;
+}
+
+/* dict_node is the first member of wuy_ttldict_node_t, so node_offset
+ * is also the offset of the dict node. */
+wuy_ttldict_t *wuy_ttldict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset)
+{
+	return wuy_ttldict_new(wuy_dict_new_func(key_hash, key_equal, node_offset),
+			node_offset);
+}
+
+wuy_ttldict_t *wuy_ttldict_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset)
+{
+	return wuy_ttldict_new(wuy_dict_new_type(key_type, key_offset, node_offset),
+			node_offset);
+}
+
+static wuy_ttldict_node_t *_item_to_node(wuy_ttldict_t *dict, const void *item)
+{
+	return (wuy_ttldict_node_t *)((char *)item + dict->node_offset);
+}
+static void *_node_to_item(wuy_ttldict_t *dict, wuy_ttldict_node_t *node)
+{
+	return (char *)node - dict->node_offset;
+}
+
+void wuy_ttldict_destroy(wuy_ttldict_t *dict)
+{
+	for (int i = 0; i < dict->slots; i++) {
+		wuy_list_node_t *lnode, *safe;
+		wuy_list_iter_safe(&dict->wheel[i], lnode, safe) {
+			wuy_ttldict_node_t *node = wuy_containerof(lnode,
+					wuy_ttldict_node_t, wheel_node);
+			if (dict->expire_handler != NULL) {
+				dict->expire_handler(_node_to_item(dict, node));
+			}
+		}
+	}
+	wuy_dict_destroy(dict->dict);
+	free(dict->wheel);
+	free(dict);
+}
+
+void wuy_ttldict_set_wheel(wuy_ttldict_t *dict, int slots, long resolution)
+{
+	assert(wuy_dict_count(dict->dict) == 0);
+	assert(slots > 0 && resolution > 0);
+
+	int align = 1;
+	while (align < slots) {
+		align <<= 1;
+	}
+
+	free(dict->wheel);
+	dict->slots = align;
+	dict->resolution = resolution;
+	dict->wheel = wuy_ttldict_wheel_new(align);
+	dict->reap_tick = wuy_time_mono_ms() / resolution;
+}
+
+void wuy_ttldict_set_expire(wuy_ttldict_t *dict, wuy_ttldict_expire_f *handler)
+{
+	dict->expire_handler = handler;
+}
+
+static void wuy_ttldict_schedule(wuy_ttldict_t *dict, wuy_ttldict_node_t *node, long ttl)
+{
+	node->expire = wuy_time_mono_ms() + ttl;
+
+	long tick = node->expire / dict->resolution;
+	if (tick < dict->reap_tick) {
+		tick = dict->reap_tick;
+	}
+	wuy_list_append(&dict->wheel[tick & (dict->slots - 1)], &node->wheel_node);
+}
+
+void wuy_ttldict_add(wuy_ttldict_t *dict, void *item, long ttl)
+{
+	wuy_dict_add(dict->dict, item);
+	wuy_ttldict_schedule(dict, _item_to_node(dict, item), ttl);
+}
+
+void wuy_ttldict_touch(wuy_ttldict_t *dict, void *item, long ttl)
+{
+	wuy_ttldict_node_t *node = _item_to_node(dict, item);
+	wuy_list_delete(&node->wheel_node);
+	wuy_ttldict_schedule(dict, node, ttl);
+}
+
+void wuy_ttldict_delete(wuy_ttldict_t *dict, void *item)
+{
+	wuy_dict_delete(dict->dict, item);
+	wuy_list_delete(&_item_to_node(dict, item)->wheel_node);
+}
+
+static void wuy_ttldict_expire(wuy_ttldict_t *dict, void *item)
+{
+	wuy_ttldict_delete(dict, item);
+	if (dict->expire_handler != NULL) {
+		dict->expire_handler(item);
+	}
+}
+
+void *_wuy_ttldict_get(wuy_ttldict_t *dict, const void *key)
+{
+	void *item = _wuy_dict_get(dict->dict, key);
+	if (item == NULL) {
+		return NULL;
+	}
+	if (_item_to_node(dict, item)->expire <= wuy_time_mono_ms()) {
+		wuy_ttldict_expire(dict, item);
+		return NULL;
+	}
+	return item;
+}
+
+void *_wuy_ttldict_del_key(wuy_ttldict_t *dict, const void *key)
+{
+	void *item = _wuy_dict_get(dict->dict, key);
+	if (item == NULL) {
+		return NULL;
+	}
+	wuy_ttldict_delete(dict, item);
+	return item;
+}
+
+int wuy_ttldict_reap(wuy_ttldict_t *dict, int budget)
+{
+	long now = wuy_time_mono_ms();
+	long now_tick = now / dict->resolution;
+
+	/* one round covers all slots */
+	if (now_tick - dict->reap_tick >= dict->slots) {
+		dict->reap_tick = now_tick - dict->slots + 1;
+	}
+
+	int count = 0;
+	while (1) {
+		wuy_list_t *slot = &dict->wheel[dict->reap_tick & (dict->slots - 1)];
+		wuy_list_node_t *lnode, *safe;
+		wuy_list_iter_safe(slot, lnode, safe) {
+			wuy_ttldict_node_t *node = wuy_containerof(lnode,
+					wuy_ttldict_node_t, wheel_node);
+			if (node->expire > now) {
+				continue;
+			}
+			if (count == budget) {
+				/* continue this slot at next time */
+				return count;
+			}
+			wuy_ttldict_expire(dict, _node_to_item(dict, node));
+			count++;
+		}
+
+		/* stay at current tick, since new items may be added into it */
+		if (dict->reap_tick >= now_tick) {
+			return count;
+		}
+		dict->reap_tick++;
+	}
+}
+
+size_t wuy_ttldict_count(wuy_ttldict_t *dict)
+{
+	return wuy_dict_count(dict->dict);
+}
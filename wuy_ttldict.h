@@ -0,0 +1,155 @@
+/**
+ * @file     wuy_ttldict.h
+ * @author   Wu Bingzheng <wubingzheng@gmail.com>
+ * @date     2021-7-27
+ *
+ * @section LICENSE
+ * GPLv2
+ *
+ * @section DESCRIPTION
+ *
+ * A dictionary whose items expire, based on wuy_dict and a hashed
+ * timer wheel.
+ *
+ * Each item carries an expire time. The expired items are removed
+ * lazily when searched, and incrementally by wuy_ttldict_reap() which
+ * should be called periodically, e.g. at each loop of the event loop.
+ *
+ * Adding, touching and deleting items are all O(1).
+ */
+
+#ifndef WUY_TTLDICT_H
+#define WUY_TTLDICT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wuy_dict.h"
+#include "wuy_list.h"
+
+/**
+ * @brief The dict.
+ *
+ * You should always use its pointer, and can not touch inside.
+ */
+typedef struct wuy_ttldict_s wuy_ttldict_t;
+
+/**
+ * @brief Embed this node into your data struct in order to use this lib.
+ *
+ * You need not initialize or touch it.
+ */
+typedef struct {
+	wuy_dict_node_t		dict_node;
+	wuy_list_node_t		wheel_node;
+	long			expire;
+} wuy_ttldict_node_t;
+
+/**
+ * @brief Called when an item expires.
+ */
+typedef void wuy_ttldict_expire_f(void *item);
+
+/**
+ * @brief Create a dict, with the user-defined key hash/equal function.
+ *
+ * @param node_offset the offset of wuy_ttldict_node_t in your data struct.
+ *
+ * Other parameters are same with wuy_dict_new_func().
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_ttldict_t *wuy_ttldict_new_func(wuy_dict_hash_f *key_hash,
+		wuy_dict_equal_f *key_equal, size_t node_offset);
+
+/**
+ * @brief Create a dict, with general key type.
+ *
+ * @param node_offset the offset of wuy_ttldict_node_t in your data struct.
+ *
+ * Other parameters are same with wuy_dict_new_type().
+ *
+ * @return the new dict. It aborts the program if memory allocation fails.
+ */
+wuy_ttldict_t *wuy_ttldict_new_type(wuy_dict_key_type_e key_type,
+		size_t key_offset, size_t node_offset);
+
+/**
+ * @brief Destroy the dict. The expire handler is called for all items if set.
+ */
+void wuy_ttldict_destroy(wuy_ttldict_t *dict);
+
+/**
+ * @brief Set the timer wheel, 4096 slots of 100 milliseconds by default.
+ *
+ * A wheel round should cover most TTLs, otherwise reaping scans
+ * the items in later rounds repeatedly.
+ *
+ * @param slots the number of slots, rounded up to power of 2.
+ * @param resolution the milliseconds of each slot.
+ *
+ * @note You MUST NOT call this after adding any item.
+ */
+void wuy_ttldict_set_wheel(wuy_ttldict_t *dict, int slots, long resolution);
+
+/**
+ * @brief Set the handler called when an item expires.
+ *
+ * The item has been removed from dict when the handler is called.
+ */
+void wuy_ttldict_set_expire(wuy_ttldict_t *dict, wuy_ttldict_expire_f *handler);
+
+/**
+ * @brief Add the item into dict, which expires after ttl milliseconds.
+ */
+void wuy_ttldict_add(wuy_ttldict_t *dict, void *item, long ttl);
+
+/**
+ * @brief Reset the item to expire after ttl milliseconds.
+ */
+void wuy_ttldict_touch(wuy_ttldict_t *dict, void *item, long ttl);
+
+/**
+ * @brief Search item from dict by the key.
+ *
+ * If the item is found but expired, it is removed and the expire
+ * handler is called, and NULL is returned.
+ *
+ * The \b key is same with wuy_dict_get().
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_ttldict_get(dict, key) _wuy_ttldict_get(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_ttldict_get. You should not use this directly. */
+void *_wuy_ttldict_get(wuy_ttldict_t *dict, const void *key);
+
+/**
+ * @brief Delete the item from dict. The expire handler is not called.
+ */
+void wuy_ttldict_delete(wuy_ttldict_t *dict, void *item);
+
+/**
+ * @brief Delete a key from dict. The expire handler is not called.
+ *
+ * @return the item if found, or NULL.
+ */
+#define wuy_ttldict_del_key(dict, key) _wuy_ttldict_del_key(dict, (const void *)(uintptr_t)(key))
+
+/* Used by macro wuy_ttldict_del_key. You should not use this directly. */
+void *_wuy_ttldict_del_key(wuy_ttldict_t *dict, const void *key);
+
+/**
+ * @brief Remove the expired items, at most budget items in one call.
+ *
+ * @return the number of removed items.
+ */
+int wuy_ttldict_reap(wuy_ttldict_t *dict, int budget);
+
+/**
+ * @brief Return the count of items in dict, including the expired
+ * ones not removed yet.
+ */
+size_t wuy_ttldict_count(wuy_ttldict_t *dict);
+
+#endif